@@ -74,11 +74,12 @@ bool EXPORT_API hasData(int tileX, int tileY, int levelOfDetail) {
 }
 
 /************* Search API *****************/
-void EXPORT_API getDataByText(int tag, const char *notTerms, const char *andTerms, const char *orTerms,
+std::uint64_t EXPORT_API getDataByText(int tag, const char *notTerms, const char *andTerms, const char *orTerms,
                               double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, int startLod, int endLod,
+                              int limit, int offset, std::uint64_t continuation,
                               OnElementLoaded *elementCallback, OnError *errorCallback, utymap::CancellationToken *cancellationToken) {
-  applicationPtr->getSearch().getDataByText(tag, notTerms, andTerms, orTerms, minLatitude, minLongitude,maxLatitude, maxLongitude,
-    startLod, endLod, elementCallback, errorCallback, cancellationToken);
+  return applicationPtr->getSearch().getDataByText(tag, notTerms, andTerms, orTerms, minLatitude, minLongitude,maxLatitude, maxLongitude,
+    startLod, endLod, limit, offset, continuation, elementCallback, errorCallback, cancellationToken);
 }
 
 void EXPORT_API getDataByQuadKey(int tag, const char *styleFile, int tileX, int tileY, int levelOfDetail, int eleDataType,
@@ -5,8 +5,11 @@
 #include "entities/Way.hpp"
 #include "entities/Area.hpp"
 #include "entities/Relation.hpp"
+#include "index/SearchPage.hpp"
 #include "math/Mesh.hpp"
 
+#include <algorithm>
+
 /// Exposes search API.
 class Search {
 public:
@@ -15,7 +18,9 @@ public:
 
   /// Gets data represented by elements matching given text query.
   /// Note, that styles and real elevation height are not included.
-  void getDataByText(int tag,                                  // request tag
+  /// Returns continuation token of the next page or zero if there are no more results.
+  /// Element is visited once per page, but it can be returned again by one of the next pages.
+  std::uint64_t getDataByText(int tag,                         // request tag
                      const char *notTerms,                     // NOT terms
                      const char *andTerms,                     // AND terms
                      const char *orTerms,                      // OR terms
@@ -25,6 +30,9 @@ public:
                      double maxLongitude,                      // max longitude
                      int startLod,                             // start lod
                      int endLod,                               // end lod
+                     int limit,                                // max amount of elements, zero means no limit
+                     int offset,                               // amount of elements to skip
+                     std::uint64_t continuation,               // continuation token, zero for the first page
                      OnElementLoaded *elementCallback,         // element callback
                      OnError *errorCallback,                   // error callback
                      utymap::CancellationToken *cancellationToken) {
@@ -32,9 +40,13 @@ public:
                              utymap::GeoCoordinate(maxLatitude, maxLongitude));
     utymap::LodRange lodRange(startLod, endLod);
     ExportElementVisitor elementVisitor(tag, context_.stringTable, elementCallback);
+    utymap::index::SearchPage page(static_cast<std::uint32_t>(std::max(limit, 0)),
+                                   static_cast<std::uint32_t>(std::max(offset, 0)),
+                                   continuation);
     ::safeExecute([&]() {
-      context_.geoStore.search(notTerms, andTerms, orTerms, bbox, lodRange, elementVisitor, *cancellationToken);
+      context_.geoStore.search(notTerms, andTerms, orTerms, bbox, lodRange, elementVisitor, page, *cancellationToken);
     }, errorCallback);
+    return page.next();
   }
 
   /// Gets data represented by elements and meshes for given quad key.
@@ -38,6 +38,18 @@ struct CountableOsmDataVisitor : public utymap::entities::ElementVisitor {
     relations++;
   }
 
+  void visitNode(uint64_t id, utymap::GeoCoordinate &coordinate, std::vector<utymap::entities::Tag> &tags) {
+    nodes++;
+  }
+
+  void visitWay(uint64_t id, std::vector<uint64_t> &nodeIds, std::vector<utymap::entities::Tag> &tags) {
+    ways++;
+  }
+
+  void visitRelation(uint64_t id, RelationMembers &members, std::vector<utymap::entities::Tag> &tags) {
+    relations++;
+  }
+
   void visitNode(const utymap::entities::Node &) override {
     ++nodes;
   }
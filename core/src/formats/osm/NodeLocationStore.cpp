@@ -0,0 +1,229 @@
+#include "formats/osm/NodeLocationStore.hpp"
+#include "utils/CoreUtils.hpp"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace utymap;
+using namespace utymap::formats;
+
+namespace {
+/// Amount of units in one degree.
+const double Precision = 1E7;
+
+/// Amount of locations in one page of dense store.
+const std::uint64_t PageSize = 4096;
+/// Amount of pages in one mapped segment of dense store.
+const std::uint32_t SegmentPages = 256;
+/// Amount of attempts to create unique file.
+const int MaxFileAttempts = 16;
+
+/// Returns directory for temporary files.
+std::string getTempDirectory() {
+  for (const char *name : { "TMPDIR", "TEMP", "TMP" }) {
+    const char *value = std::getenv(name);
+    if (value != nullptr && *value != '\0')
+      return value;
+  }
+  return "/tmp";
+}
+
+/// Creates new file with unique name in given directory and returns its path.
+std::string createUniqueFile(const std::string &directory) {
+  static std::atomic<std::uint32_t> counter(0);
+  std::random_device device;
+  for (int attempt = 0; attempt < MaxFileAttempts; ++attempt) {
+    std::stringstream ss;
+    ss << directory << "/utymap-" << std::hex << device() << "-" << counter++ << ".locations";
+    auto path = ss.str();
+    // NOTE "x" mode fails if file exists, so other store cannot share it.
+    std::FILE *file = std::fopen(path.c_str(), "wbx");
+    if (file != nullptr) {
+      std::fclose(file);
+      return path;
+    }
+  }
+  throw std::domain_error("Cannot create node location file in " + directory);
+}
+}
+
+NodeLocationStore::Location NodeLocationStore::pack(const GeoCoordinate &coordinate) {
+  // NOTE shift values to positive range and reserve zero for missing location.
+  return Location{ static_cast<std::uint32_t>(std::lround((coordinate.latitude + 90) * Precision)) + 1,
+                   static_cast<std::uint32_t>(std::lround((coordinate.longitude + 180) * Precision)) + 1 };
+}
+
+GeoCoordinate NodeLocationStore::unpack(const Location &location) {
+  return GeoCoordinate((location.latitude - 1) / Precision - 90,
+                       (location.longitude - 1) / Precision - 180);
+}
+
+// SparseNodeLocationStore
+
+SparseNodeLocationStore::SparseNodeLocationStore() : locations_(), sorted_(0) {
+}
+
+void SparseNodeLocationStore::set(std::uint64_t id, const GeoCoordinate &coordinate) {
+  // NOTE nodes are usually sorted by id in osm files, so sorting is rarely needed.
+  bool isSorted = sorted_ == locations_.size() && (locations_.empty() || locations_.back().first < id);
+  locations_.push_back(std::make_pair(id, pack(coordinate)));
+  if (isSorted) sorted_ = locations_.size();
+}
+
+bool SparseNodeLocationStore::get(std::uint64_t id, GeoCoordinate &coordinate) {
+  if (sorted_ != locations_.size()) {
+    std::stable_sort(locations_.begin(), locations_.end(),
+                     [](const std::pair<std::uint64_t, Location> &l, const std::pair<std::uint64_t, Location> &r) {
+                       return l.first < r.first;
+                     });
+    // keep the last location of the node.
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < locations_.size(); ++i) {
+      if (size > 0 && locations_[size - 1].first == locations_[i].first)
+        locations_[size - 1] = locations_[i];
+      else
+        locations_[size++] = locations_[i];
+    }
+    locations_.resize(size);
+    sorted_ = size;
+  }
+
+  auto it = std::lower_bound(locations_.begin(), locations_.end(), id,
+                             [](const std::pair<std::uint64_t, Location> &l, std::uint64_t id) {
+                               return l.first < id;
+                             });
+  if (it == locations_.end() || it->first != id)
+    return false;
+
+  coordinate = unpack(it->second);
+  return true;
+}
+
+// DenseNodeLocationStore
+
+class DenseNodeLocationStore::DenseNodeLocationStoreImpl final {
+  using Segment = std::unique_ptr<boost::interprocess::mapped_region>;
+ public:
+  explicit DenseNodeLocationStoreImpl(const std::string &directory) :
+      path_(createUniqueFile(directory)), pages_(), segments_(), slots_(0),
+      lastPage_(std::numeric_limits<std::uint64_t>::max()), lastData_(nullptr) {
+  }
+
+  ~DenseNodeLocationStoreImpl() {
+    segments_.clear();
+    std::remove(path_.c_str());
+  }
+
+  const std::string &path() const { return path_; }
+
+  void set(std::uint64_t id, const Location &location) {
+    Location *page = findPage(id / PageSize);
+    if (page == nullptr)
+      page = addPage(id / PageSize);
+    page[id % PageSize] = location;
+  }
+
+  bool get(std::uint64_t id, Location &location) {
+    const Location *page = findPage(id / PageSize);
+    if (page == nullptr)
+      return false;
+    location = page[id % PageSize];
+    return location.latitude != 0;
+  }
+
+ private:
+  /// Returns data of given page or nullptr if page is not allocated.
+  Location *findPage(std::uint64_t page) {
+    // NOTE nodes are usually sorted by id, so the same page is requested many times.
+    if (page == lastPage_)
+      return lastData_;
+
+    auto it = pages_.find(page);
+    if (it == pages_.end())
+      return nullptr;
+
+    lastPage_ = page;
+    lastData_ = slotData(it->second);
+    return lastData_;
+  }
+
+  /// Allocates zeroed page in the file.
+  Location *addPage(std::uint64_t page) {
+    if (slots_ % SegmentPages == 0)
+      addSegment();
+    pages_[page] = slots_;
+    lastPage_ = page;
+    lastData_ = slotData(slots_++);
+    return lastData_;
+  }
+
+  Location *slotData(std::uint32_t slot) const {
+    return static_cast<Location *>(segments_[slot / SegmentPages]->get_address()) + (slot % SegmentPages) * PageSize;
+  }
+
+  /// Extends file by one segment and maps it. Already mapped segments are kept.
+  void addSegment() {
+    using namespace boost::interprocess;
+    const std::uint64_t segmentSize = SegmentPages * PageSize * sizeof(Location);
+    const std::uint64_t offset = segments_.size() * segmentSize;
+    {
+      // NOTE new pages are not written, so file system keeps them zeroed.
+      std::fstream file(path_, std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(static_cast<std::streamoff>(offset + segmentSize - 1));
+      file.put(0);
+      if (!file.good())
+        throw std::domain_error("Cannot extend node location file: " + path_);
+    }
+
+    file_mapping mapping(path_.c_str(), read_write);
+    segments_.push_back(utymap::utils::make_unique<mapped_region>(
+        mapping, read_write, static_cast<offset_t>(offset), static_cast<std::size_t>(segmentSize)));
+  }
+
+  const std::string path_;
+  /// Maps page index to slot in the file.
+  std::unordered_map<std::uint64_t, std::uint32_t> pages_;
+  std::vector<Segment> segments_;
+  std::uint32_t slots_;
+  std::uint64_t lastPage_;
+  Location *lastData_;
+};
+
+DenseNodeLocationStore::DenseNodeLocationStore() :
+    DenseNodeLocationStore(getTempDirectory()) {
+}
+
+DenseNodeLocationStore::DenseNodeLocationStore(const std::string &directory) :
+    pimpl_(utymap::utils::make_unique<DenseNodeLocationStoreImpl>(directory)) {
+}
+
+DenseNodeLocationStore::~DenseNodeLocationStore() {}
+
+const std::string &DenseNodeLocationStore::path() const {
+  return pimpl_->path();
+}
+
+void DenseNodeLocationStore::set(std::uint64_t id, const GeoCoordinate &coordinate) {
+  pimpl_->set(id, pack(coordinate));
+}
+
+bool DenseNodeLocationStore::get(std::uint64_t id, GeoCoordinate &coordinate) {
+  Location location;
+  if (!pimpl_->get(id, location))
+    return false;
+
+  coordinate = unpack(location);
+  return true;
+}
@@ -0,0 +1,90 @@
+#ifndef FORMATS_OSM_NODELOCATIONSTORE_HPP_DEFINED
+#define FORMATS_OSM_NODELOCATIONSTORE_HPP_DEFINED
+
+#include "GeoCoordinate.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace utymap {
+namespace formats {
+
+/// Keeps coordinates of osm nodes during import, so ways can be resolved
+/// without keeping node objects. Coordinates are stored with osm precision
+/// (1e-7 degree) using eight bytes per node.
+class NodeLocationStore {
+ public:
+  virtual ~NodeLocationStore() = default;
+
+  /// Stores location of node with given id.
+  virtual void set(std::uint64_t id, const utymap::GeoCoordinate &coordinate) = 0;
+
+  /// Gets location of node with given id. Returns false if location is unknown.
+  virtual bool get(std::uint64_t id, utymap::GeoCoordinate &coordinate) = 0;
+
+ protected:
+  /// Location packed into unsigned fixed point values. Zero means that location is not set.
+  struct Location {
+    std::uint32_t latitude;
+    std::uint32_t longitude;
+  };
+
+  static Location pack(const utymap::GeoCoordinate &coordinate);
+
+  static utymap::GeoCoordinate unpack(const Location &location);
+};
+
+/// Keeps locations in array of id-location pairs sorted by id.
+/// Suitable for small extracts: memory depends on amount of nodes only.
+class SparseNodeLocationStore final : public NodeLocationStore {
+ public:
+  SparseNodeLocationStore();
+
+  void set(std::uint64_t id, const utymap::GeoCoordinate &coordinate) override;
+
+  bool get(std::uint64_t id, utymap::GeoCoordinate &coordinate) override;
+
+ private:
+  std::vector<std::pair<std::uint64_t, Location>> locations_;
+  /// Amount of locations which are known to be sorted.
+  std::size_t sorted_;
+};
+
+/// Keeps locations in memory mapped file split into pages of consecutive ids.
+/// Only pages with known locations are allocated, so file size depends on
+/// amount of id ranges used, not on the maximum id.
+/// Suitable for large extracts: memory is managed by OS, lookup is a hash lookup
+/// and a single read.
+class DenseNodeLocationStore final : public NodeLocationStore {
+ public:
+  /// Creates store backed by unique file in system temporary directory.
+  DenseNodeLocationStore();
+
+  /// Creates store backed by unique file in given directory.
+  /// File is removed when store is destroyed.
+  explicit DenseNodeLocationStore(const std::string &directory);
+
+  DenseNodeLocationStore(const DenseNodeLocationStore &) = delete;
+  DenseNodeLocationStore &operator=(const DenseNodeLocationStore &) = delete;
+
+  ~DenseNodeLocationStore();
+
+  /// Returns path to backing file.
+  const std::string &path() const;
+
+  void set(std::uint64_t id, const utymap::GeoCoordinate &coordinate) override;
+
+  bool get(std::uint64_t id, utymap::GeoCoordinate &coordinate) override;
+
+ private:
+  class DenseNodeLocationStoreImpl;
+  std::unique_ptr<DenseNodeLocationStoreImpl> pimpl_;
+};
+
+}
+}
+
+#endif // FORMATS_OSM_NODELOCATIONSTORE_HPP_DEFINED
@@ -6,6 +6,7 @@
 #include "formats/osm/MultipolygonProcessor.hpp"
 #include "formats/osm/RelationProcessor.hpp"
 #include "formats/osm/OsmDataVisitor.hpp"
+#include "utils/CoreUtils.hpp"
 #include "utils/GeometryUtils.hpp"
 
 #include <unordered_set>
@@ -20,19 +21,42 @@ void OsmDataVisitor::visitBounds(BoundingBox bbox) {
 }
 
 void OsmDataVisitor::visitNode(std::uint64_t id, GeoCoordinate &coordinate, utymap::formats::Tags &tags) {
+  auto convertedTags = utymap::utils::convertTags(stringTable_, tags);
+  visitNode(id, coordinate, convertedTags);
+}
+
+void OsmDataVisitor::visitNode(std::uint64_t id, GeoCoordinate &coordinate, std::vector<utymap::entities::Tag> &tags) {
+  locations_->set(id, coordinate);
+  if (tags.empty()) return;
+
   auto node = std::make_shared<Node>();
   node->id = id;
   node->coordinate = coordinate;
-  utymap::utils::setTags(stringTable_, *node, tags);
-  context_.nodeMap[id] = node;
+  node->tags = std::move(tags);
+  if (isRetained(memberNodeIds_, id))
+    context_.nodeMap[id] = node;
+  else
+    add(*node);
 }
 
 void OsmDataVisitor::visitWay(std::uint64_t id, std::vector<std::uint64_t> &nodeIds, utymap::formats::Tags &tags) {
+  auto convertedTags = utymap::utils::convertTags(stringTable_, tags);
+  visitWay(id, nodeIds, convertedTags);
+}
+
+void OsmDataVisitor::visitWay(std::uint64_t id,
+                              std::vector<std::uint64_t> &nodeIds,
+                              std::vector<utymap::entities::Tag> &tags) {
   std::vector<GeoCoordinate> coordinates;
   coordinates.reserve(nodeIds.size());
+  GeoCoordinate coordinate;
   for (auto nodeId : nodeIds) {
-    coordinates.push_back(context_.nodeMap[nodeId]->coordinate);
+    if (locations_->get(nodeId, coordinate))
+      coordinates.push_back(coordinate);
   }
+  // NOTE extracts may contain ways with nodes outside of extract.
+  if (coordinates.size() < 2) return;
+
   auto size = coordinates.size();
   if (size > 3 && coordinates[0]==coordinates[size - 1]) {
     coordinates.pop_back();
@@ -43,27 +67,48 @@ void OsmDataVisitor::visitWay(std::uint64_t id, std::vector<std::uint64_t> &node
       std::reverse(coordinates.begin(), coordinates.end());
     }
     area->coordinates = std::move(coordinates);
-    utymap::utils::setTags(stringTable_, *area, tags);
-    context_.areaMap[id] = area;
+    area->tags = std::move(tags);
+    if (isRetained(memberWayIds_, id))
+      context_.areaMap[id] = area;
+    else
+      add(*area);
 
   } else {
     auto way = std::make_shared<Way>();
     way->id = id;
     way->coordinates = std::move(coordinates);
-    utymap::utils::setTags(stringTable_, *way, tags);
-    context_.wayMap[id] = way;
+    way->tags = std::move(tags);
+    if (isRetained(memberWayIds_, id))
+      context_.wayMap[id] = way;
+    else
+      add(*way);
   }
 }
 
 void OsmDataVisitor::visitRelation(std::uint64_t id, RelationMembers &members, utymap::formats::Tags &tags) {
+  auto convertedTags = utymap::utils::convertTags(stringTable_, tags);
+  visitRelation(id, members, convertedTags);
+}
+
+void OsmDataVisitor::visitRelation(std::uint64_t id,
+                                   RelationMembers &members,
+                                   std::vector<utymap::entities::Tag> &tags) {
   auto relation = std::make_shared<Relation>();
   relation->id = id;
-  relation->tags = utymap::utils::convertTags(stringTable_, tags);
+  relation->tags = std::move(tags);
 
   // NOTE Assume, relation may refer to another relations which are not yet processed.
   // So, store all relation members to resolve them once all relations are visited.
   relationMembers_[id] = members;
   context_.relationMap[id] = relation;
+
+  if (!isStreaming_) return;
+  for (const auto &member : members) {
+    if (member.type == "n")
+      memberNodeIds_.insert(member.refId);
+    else if (member.type == "w")
+      memberWayIds_.insert(member.refId);
+  }
 }
 
 void OsmDataVisitor::add(utymap::entities::Element &element) {
@@ -77,6 +122,26 @@ bool OsmDataVisitor::hasTag(const std::string &key,
   return utymap::utils::hasTag(stringTable_.getId(key), stringTable_.getId(value), tags);
 }
 
+bool OsmDataVisitor::isRetained(const std::unordered_set<std::uint64_t> &memberIds, std::uint64_t id) const {
+  return !isStreaming_ || memberIds.find(id) != memberIds.end();
+}
+
+void OsmDataVisitor::resolveNodes() {
+  GeoCoordinate coordinate;
+  for (const auto &membersPair : relationMembers_) {
+    for (const auto &member : membersPair.second) {
+      if (member.type != "n" || context_.nodeMap.find(member.refId) != context_.nodeMap.end() ||
+          !locations_->get(member.refId, coordinate))
+        continue;
+
+      auto node = std::make_shared<Node>();
+      node->id = member.refId;
+      node->coordinate = coordinate;
+      context_.nodeMap[member.refId] = node;
+    }
+  }
+}
+
 void OsmDataVisitor::resolve(Relation &relation) {
   if (cancelToken_.isCancelled()) return;
 
@@ -100,6 +165,9 @@ utymap::BoundingBox OsmDataVisitor::complete() {
   // TODO return actual bounding box.
   if (cancelToken_.isCancelled()) return utymap::BoundingBox();
 
+  // Untagged nodes are kept as locations only.
+  resolveNodes();
+
   // All relations are visited can start to resolve them
   for (auto &membersPair : relationMembers_) {
     auto relationPair = context_.relationMap.find(membersPair.first);
@@ -129,5 +197,15 @@ utymap::BoundingBox OsmDataVisitor::complete() {
 OsmDataVisitor::OsmDataVisitor(const StringTable &stringTable,
                                std::function<bool(Element &)> add,
                                const utymap::CancellationToken &cancelToken) :
-  stringTable_(stringTable), add_(add), cancelToken_(cancelToken), context_(), bbox_() {
+  OsmDataVisitor(stringTable, add, cancelToken, utymap::utils::make_unique<SparseNodeLocationStore>()) {
+}
+
+OsmDataVisitor::OsmDataVisitor(const StringTable &stringTable,
+                               std::function<bool(Element &)> add,
+                               const utymap::CancellationToken &cancelToken,
+                               std::unique_ptr<NodeLocationStore> locations,
+                               bool isStreaming) :
+  stringTable_(stringTable), add_(add), cancelToken_(cancelToken), context_(),
+  locations_(std::move(locations)), bbox_(), relationMembers_(),
+  isStreaming_(isStreaming), memberNodeIds_(), memberWayIds_() {
 }
@@ -6,32 +6,59 @@
 #include "GeoCoordinate.hpp"
 #include "entities/Element.hpp"
 #include "formats/FormatTypes.hpp"
+#include "formats/osm/NodeLocationStore.hpp"
 #include "formats/osm/OsmDataContext.hpp"
 #include "index/StringTable.hpp"
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace utymap {
 namespace formats {
 
+/// Builds elements from osm data. Only locations of untagged nodes are kept:
+/// such nodes are created only when they are referenced by relations.
+/// In streaming mode, nodes and ways are added as soon as they are visited unless
+/// they are members of relations visited before, so relations should be visited
+/// in the first pass over data (see OsmRelationPass and OsmElementPass).
 class OsmDataVisitor final {
  public:
 
+  /// Creates visitor which keeps node locations in memory.
   OsmDataVisitor(const utymap::index::StringTable &stringTable,
                  std::function<bool(utymap::entities::Element &)> add,
                  const utymap::CancellationToken &cancelToken);
 
+  /// Creates visitor which keeps node locations in given store.
+  OsmDataVisitor(const utymap::index::StringTable &stringTable,
+                 std::function<bool(utymap::entities::Element &)> add,
+                 const utymap::CancellationToken &cancelToken,
+                 std::unique_ptr<utymap::formats::NodeLocationStore> locations,
+                 bool isStreaming = false);
+
   void visitBounds(utymap::BoundingBox bbox);
 
   void visitNode(std::uint64_t id, utymap::GeoCoordinate &coordinate, utymap::formats::Tags &tags);
 
+  /// Visits node with tags which are already interned and sorted by key.
+  void visitNode(std::uint64_t id, utymap::GeoCoordinate &coordinate, std::vector<utymap::entities::Tag> &tags);
+
   void visitWay(std::uint64_t id, std::vector<std::uint64_t> &nodeIds, utymap::formats::Tags &tags);
 
+  /// Visits way with tags which are already interned and sorted by key.
+  void visitWay(std::uint64_t id, std::vector<std::uint64_t> &nodeIds, std::vector<utymap::entities::Tag> &tags);
+
   void visitRelation(std::uint64_t id, utymap::formats::RelationMembers &members, utymap::formats::Tags &tags);
 
+  /// Visits relation with tags which are already interned and sorted by key.
+  void visitRelation(std::uint64_t id,
+                     utymap::formats::RelationMembers &members,
+                     std::vector<utymap::entities::Tag> &tags);
+
   void add(utymap::entities::Element &element);
 
   utymap::BoundingBox complete();
@@ -40,13 +67,70 @@ class OsmDataVisitor final {
 
   bool hasTag(const std::string &key, const std::string &value, const std::vector<utymap::entities::Tag> &tags) const;
   void resolve(utymap::entities::Relation &relation);
+  void resolveNodes();
+  bool isRetained(const std::unordered_set<std::uint64_t> &memberIds, std::uint64_t id) const;
 
   const utymap::index::StringTable &stringTable_;
   std::function<bool(utymap::entities::Element &)> add_;
   const utymap::CancellationToken &cancelToken_;
   utymap::formats::OsmDataContext context_;
+  std::unique_ptr<utymap::formats::NodeLocationStore> locations_;
   utymap::BoundingBox bbox_;
   std::unordered_map<std::uint64_t, utymap::formats::RelationMembers> relationMembers_;
+
+  const bool isStreaming_;
+  std::unordered_set<std::uint64_t> memberNodeIds_;
+  std::unordered_set<std::uint64_t> memberWayIds_;
+};
+
+/// Passes only relations to visitor: first pass of streaming import.
+template<typename Visitor>
+class OsmRelationPass final {
+ public:
+  explicit OsmRelationPass(Visitor &visitor) : visitor_(visitor) {}
+
+  void visitBounds(utymap::BoundingBox bbox) {}
+
+  template<typename Tags>
+  void visitNode(std::uint64_t id, utymap::GeoCoordinate &coordinate, Tags &tags) {}
+
+  template<typename Tags>
+  void visitWay(std::uint64_t id, std::vector<std::uint64_t> &nodeIds, Tags &tags) {}
+
+  template<typename Tags>
+  void visitRelation(std::uint64_t id, utymap::formats::RelationMembers &members, Tags &tags) {
+    visitor_.visitRelation(id, members, tags);
+  }
+
+ private:
+  Visitor &visitor_;
+};
+
+/// Passes everything except relations to visitor: second pass of streaming import.
+template<typename Visitor>
+class OsmElementPass final {
+ public:
+  explicit OsmElementPass(Visitor &visitor) : visitor_(visitor) {}
+
+  void visitBounds(utymap::BoundingBox bbox) {
+    visitor_.visitBounds(bbox);
+  }
+
+  template<typename Tags>
+  void visitNode(std::uint64_t id, utymap::GeoCoordinate &coordinate, Tags &tags) {
+    visitor_.visitNode(id, coordinate, tags);
+  }
+
+  template<typename Tags>
+  void visitWay(std::uint64_t id, std::vector<std::uint64_t> &nodeIds, Tags &tags) {
+    visitor_.visitWay(id, nodeIds, tags);
+  }
+
+  template<typename Tags>
+  void visitRelation(std::uint64_t id, utymap::formats::RelationMembers &members, Tags &tags) {}
+
+ private:
+  Visitor &visitor_;
 };
 
 }
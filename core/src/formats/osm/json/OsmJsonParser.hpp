@@ -44,7 +44,6 @@ class OsmJsonParser {
 
   OsmJsonParser(const utymap::index::StringTable &stringTable) :
       stringTable_(stringTable),
-      idKey_(stringTable.getId(IdAttributeName)),
       featureKey_(stringTable.getId(FeatureAttributeName)) {
   }
 
@@ -179,14 +178,22 @@ class OsmJsonParser {
 
   void parseProperties(utymap::entities::Element &element, std::uint32_t featureId, const ptree &properties) const {
     element.id = 0;
+    // NOTE keys and values are interned in one batch, id value is not interned.
+    std::vector<const std::string *> strings;
     for (const ptree::value_type &property : properties) {
-      std::uint32_t key = stringTable_.getId(property.first);
-      if (key==idKey_)
+      if (property.first==IdAttributeName)
         element.id = parseId(property.second.data());
-      else
-        element.tags.emplace_back(key, stringTable_.getId(property.second.data()));
+      else {
+        strings.push_back(&property.first);
+        strings.push_back(&property.second.data());
+      }
     }
 
+    std::vector<std::uint32_t> ids;
+    stringTable_.getIds(strings, ids);
+    for (std::size_t i = 0; i < ids.size(); i += 2)
+      element.tags.emplace_back(ids[i], ids[i + 1]);
+
     // NOTE add artificial tag for mapcss processing.
     element.tags.emplace_back(featureKey_, featureId);
 
@@ -205,7 +212,6 @@ class OsmJsonParser {
   }
 
   const utymap::index::StringTable &stringTable_;
-  const std::uint32_t idKey_;
   const std::uint32_t featureKey_;
 };
 
@@ -2,109 +2,420 @@
 #define FORMATS_PBF_OSMPBFPARSER_HPP_INCLUDED
 
 #include "BoundingBox.hpp"
+#include "entities/Element.hpp"
 #include "formats/FormatTypes.hpp"
+#include "index/StringTable.hpp"
 
 #include <fileformat.pb.h>
 #include <osmformat.pb.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <exception>
 #include <istream>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
 namespace utymap {
 namespace formats {
 
+/// Parses osm pbf files using pipeline: reader thread slices stream into blobs,
+/// worker threads inflate and decode them into plain structures and calling thread
+/// visits decoded blocks in file order, so visitor is never called concurrently.
+/// Optional bounding box filters data while it is decoded: nodes outside of it are
+/// visited without tags, so ways crossing its border keep their geometry. Ways and
+/// relations are kept only if they refer to nodes inside or to other kept elements.
+/// Only strings used by tags of kept elements are interned, once per block, so visitor
+/// receives tags as pairs of string ids sorted by key.
 template<typename Visitor>
 class OsmPbfParser final {
   const static int MaxBlobHeaderSize = 64*1024;
   const static int MaxUncompressedBlobSize = 32*1024*1024;
+  /// Amount of blocks which can be read or decoded ahead of visitor per worker.
+  const static std::size_t BlocksPerWorker = 2;
 
  public:
 
-  OsmPbfParser() :
-      buffer_(MaxUncompressedBlobSize),
-      unpack_buffer_(MaxUncompressedBlobSize),
-      finished_(false) {
+  /// Creates parser which uses given amount of decoding threads.
+  explicit OsmPbfParser(const utymap::index::StringTable &stringTable,
+                        std::size_t workers = std::thread::hardware_concurrency()) :
+      stringTable_(stringTable), workers_(std::max<std::size_t>(workers, 1)) {
   }
 
   void parse(std::istream &stream, Visitor &visitor) {
-    finished_ = false;
-
-    while (!stream.eof() && !stream.fail() && !finished_) {
-      OSMPBF::BlobHeader header = readHeader(stream);
-      if (!finished_) {
-        std::int32_t sz = readBlob(header, stream);
-        if (header.type()=="OSMData") {
-          parsePrimitiveBlock(sz, visitor);
-        } else if (header.type()=="OSMHeader") {
-          // used to be skipped
+    parse(stream, visitor, utymap::BoundingBox());
+  }
+
+  /// Parses elements which belong to given bounding box. Invalid bounding box disables filtering.
+  void parse(std::istream &stream, Visitor &visitor, const utymap::BoundingBox &bbox) {
+    Pipeline pipeline(stream, bbox, workers_);
+    bool isFiltered = bbox.isValid();
+    IdSet nodeIds, wayIds, relationIds;
+
+    Block block;
+    while (pipeline.next(block)) {
+      // NOTE elements are filtered before visiting, so strings of dropped ones are not interned.
+      if (isFiltered) {
+        for (const auto &node : block.nodes) {
+          if (bbox.contains(node.coordinate)) nodeIds.insert(node.id);
         }
+
+        keep(block.ways, [&](const Way &way) {
+          if (!nodeIds.containsAny(way.nodeIds.begin(), way.nodeIds.end())) return false;
+          wayIds.insert(way.id);
+          return true;
+        });
+
+        keep(block.relations, [&](const Relation &relation) {
+          auto isKept = [&](const RelationMember &member) {
+            auto &ids = member.type == "n" ? nodeIds : (member.type == "w" ? wayIds : relationIds);
+            return ids.contains(member.refId);
+          };
+          if (std::none_of(relation.members.begin(), relation.members.end(), isKept)) return false;
+          relationIds.insert(relation.id);
+          return true;
+        });
       }
+
+      internTags(block);
+      for (auto &node : block.nodes)
+        visitor.visitNode(node.id, node.coordinate, node.tags);
+      for (auto &way : block.ways)
+        visitor.visitWay(way.id, way.nodeIds, way.tags);
+      for (auto &relation : block.relations)
+        visitor.visitRelation(relation.id, relation.members, relation.tags);
     }
   }
 
  private:
 
-  std::vector<char> buffer_;
-  std::vector<char> unpack_buffer_;
-  bool finished_;
+  typedef std::vector<utymap::entities::Tag> EntityTags;
+
+  struct Node final {
+    std::uint64_t id;
+    GeoCoordinate coordinate;
+    EntityTags tags;
+  };
+
+  struct Way final {
+    std::uint64_t id;
+    std::vector<std::uint64_t> nodeIds;
+    EntityTags tags;
+  };
+
+  struct Relation final {
+    std::uint64_t id;
+    RelationMembers members;
+    EntityTags tags;
+  };
+
+  /// Decoded primitive block. Tags of its elements refer to block strings
+  /// until they are interned.
+  struct Block final {
+    std::vector<std::string> strings;
+    std::vector<Node> nodes;
+    std::vector<Way> ways;
+    std::vector<Relation> relations;
+  };
+
+  /// Removes elements which are not accepted by predicate. Predicate is called in element order.
+  template<typename T, typename Predicate>
+  static void keep(std::vector<T> &elements, const Predicate &predicate) {
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+      if (!predicate(elements[i])) continue;
+      if (size != i)
+        elements[size] = std::move(elements[i]);
+      ++size;
+    }
+    elements.resize(size);
+  }
 
-  OSMPBF::BlobHeader readHeader(std::istream &stream) {
-    std::int32_t sz;
-    OSMPBF::BlobHeader result;
+  /// Replaces indices of block strings in tags by string ids. Strings used by tags
+  /// are interned in single batch, the rest of block strings are ignored.
+  void internTags(Block &block) const {
+    const std::uint32_t NoSlot = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> slots(block.strings.size(), NoSlot);
+    std::vector<const std::string *> strings;
+    auto collect = [&](const EntityTags &tags) {
+      for (const auto &tag : tags) {
+        for (auto index : { tag.key, tag.value }) {
+          if (slots[index] != NoSlot) continue;
+          slots[index] = static_cast<std::uint32_t>(strings.size());
+          strings.push_back(&block.strings[index]);
+        }
+      }
+    };
+    for (const auto &node : block.nodes) collect(node.tags);
+    for (const auto &way : block.ways) collect(way.tags);
+    for (const auto &relation : block.relations) collect(relation.tags);
+    if (strings.empty()) return;
+
+    std::vector<std::uint32_t> ids;
+    stringTable_.getIds(strings, ids);
+    auto remap = [&](EntityTags &tags) {
+      for (auto &tag : tags) {
+        tag.key = ids[slots[tag.key]];
+        tag.value = ids[slots[tag.value]];
+      }
+      std::sort(tags.begin(), tags.end());
+    };
+    for (auto &node : block.nodes) remap(node.tags);
+    for (auto &way : block.ways) remap(way.tags);
+    for (auto &relation : block.relations) remap(relation.tags);
+  }
 
-    // read size of blob-header
-    if (!stream.read(reinterpret_cast<char *>(&sz), 4)) {
-      finished_ = true;
-      return result;
+  /// Keeps ids of visited elements. Ids are usually sorted in osm files,
+  /// so they are kept in sorted array which is sorted again only if needed.
+  class IdSet final {
+   public:
+    void insert(std::uint64_t id) {
+      isSorted_ = isSorted_ && (ids_.empty() || ids_.back() < id);
+      ids_.push_back(id);
     }
 
-    // little endian to big endian
-    sz = (((sz & 0xff) << 24) + ((sz & 0xff00) << 8) + ((sz & 0xff0000) >> 8) + ((sz >> 24) & 0xff));
+    bool contains(std::uint64_t id) {
+      if (!isSorted_) {
+        std::sort(ids_.begin(), ids_.end());
+        isSorted_ = true;
+      }
+      return std::binary_search(ids_.begin(), ids_.end(), id);
+    }
 
-    if (sz > MaxBlobHeaderSize)
-      throw std::domain_error("Blob header size is bigger than allowed");
+    template<typename Iterator>
+    bool containsAny(Iterator begin, Iterator end) {
+      for (; begin != end; ++begin)
+        if (contains(*begin)) return true;
+      return false;
+    }
 
-    stream.read(buffer_.data(), sz);
-    if (!stream.good())
-      throw std::domain_error("Unable to read blob header from file");
+   private:
+    std::vector<std::uint64_t> ids_;
+    bool isSorted_ = true;
+  };
+
+  /// Serialized OSMData blob with its position in file.
+  struct RawBlob final {
+    std::size_t index;
+    std::vector<char> data;
+  };
+
+  /// Runs reader and decoding threads for single stream. Decoded blocks are taken
+  /// in file order by calling thread. Threads are stopped when pipeline is destroyed.
+  class Pipeline final {
+   public:
+    Pipeline(std::istream &stream,
+             const utymap::BoundingBox &bbox,
+             std::size_t workers) :
+        stream_(stream), bbox_(bbox), capacity_(workers * BlocksPerWorker),
+        blobs_(), blocks_(), read_(0), visited_(0),
+        isRead_(false), isStopped_(false), error_(), lock_(), signal_(), threads_() {
+      threads_.emplace_back(&Pipeline::readBlobs, this);
+      for (std::size_t i = 0; i < workers; ++i)
+        threads_.emplace_back(&Pipeline::decodeBlobs, this);
+    }
 
-    if (!result.ParseFromArray(buffer_.data(), sz))
-      throw std::domain_error("Unable to parse blob header");
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
 
-    return result;
-  }
+    ~Pipeline() {
+      stop(nullptr);
+      for (auto &thread : threads_)
+        thread.join();
+    }
 
-  std::int32_t readBlob(const OSMPBF::BlobHeader &header, std::istream &stream) {
-    OSMPBF::Blob blob;
+    /// Takes next decoded block. Returns false if there are no more blocks.
+    bool next(Block &block) {
+      std::unique_lock<std::mutex> lock(lock_);
+      signal_.wait(lock, [&]() {
+        return error_ != nullptr || blocks_.find(visited_) != blocks_.end() || (isRead_ && visited_ == read_);
+      });
+
+      if (error_ != nullptr)
+        std::rethrow_exception(error_);
+
+      auto it = blocks_.find(visited_);
+      if (it == blocks_.end())
+        return false;
+
+      block = std::move(it->second);
+      blocks_.erase(it);
+      ++visited_;
+      lock.unlock();
+      signal_.notify_all();
+      return true;
+    }
+
+   private:
+    void stop(std::exception_ptr error) {
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        isStopped_ = true;
+        if (error_ == nullptr)
+          error_ = error;
+      }
+      signal_.notify_all();
+    }
+
+    void readBlobs() {
+      try {
+        std::vector<char> buffer(MaxBlobHeaderSize);
+        OSMPBF::BlobHeader header;
+        while (readHeader(buffer, header)) {
+          RawBlob blob{ 0, readBlob(header) };
+          // NOTE nothing to read when whole file is outside of bounding box.
+          if (header.type() == "OSMHeader" && !isInside(blob.data))
+            break;
+          if (header.type() != "OSMData")
+            continue;
+
+          std::unique_lock<std::mutex> lock(lock_);
+          signal_.wait(lock, [&]() { return isStopped_ || read_ - visited_ < capacity_; });
+          if (isStopped_) return;
+          blob.index = read_++;
+          blobs_.push_back(std::move(blob));
+          lock.unlock();
+          signal_.notify_all();
+        }
+        {
+          std::lock_guard<std::mutex> lock(lock_);
+          isRead_ = true;
+        }
+        signal_.notify_all();
+      } catch (...) {
+        stop(std::current_exception());
+      }
+    }
+
+    void decodeBlobs() {
+      try {
+        while (true) {
+          RawBlob blob;
+          {
+            std::unique_lock<std::mutex> lock(lock_);
+            signal_.wait(lock, [&]() { return isStopped_ || isRead_ || !blobs_.empty(); });
+            if (isStopped_ || blobs_.empty()) return;
+            blob = std::move(blobs_.front());
+            blobs_.pop_front();
+          }
+
+          Block block;
+          std::string raw;
+          readBlobContent(blob.data, raw);
+          decodePrimitiveBlock(raw, bbox_, block);
+          {
+            std::lock_guard<std::mutex> lock(lock_);
+            blocks_.emplace(blob.index, std::move(block));
+          }
+          signal_.notify_all();
+        }
+      } catch (...) {
+        stop(std::current_exception());
+      }
+    }
+
+    bool readHeader(std::vector<char> &buffer, OSMPBF::BlobHeader &header) {
+      std::int32_t sz;
 
-    std::int32_t sz = header.datasize();
+      // read size of blob-header
+      if (!stream_.read(reinterpret_cast<char *>(&sz), 4))
+        return false;
 
-    if (sz > MaxUncompressedBlobSize)
-      throw std::domain_error("Blob size is bigger then allowed");
+      // little endian to big endian
+      sz = (((sz & 0xff) << 24) + ((sz & 0xff00) << 8) + ((sz & 0xff0000) >> 8) + ((sz >> 24) & 0xff));
+
+      if (sz > MaxBlobHeaderSize)
+        throw std::domain_error("Blob header size is bigger than allowed");
+
+      stream_.read(buffer.data(), sz);
+      if (!stream_.good())
+        throw std::domain_error("Unable to read blob header from file");
+
+      if (!header.ParseFromArray(buffer.data(), sz))
+        throw std::domain_error("Unable to parse blob header");
+
+      return true;
+    }
+
+    /// Checks whether bounding box of file specified by header block intersects given one.
+    bool isInside(const std::vector<char> &data) const {
+      if (!bbox_.isValid())
+        return true;
+
+      std::string raw;
+      readBlobContent(data, raw);
+      OSMPBF::HeaderBlock header;
+      if (!header.ParseFromString(raw))
+        throw std::domain_error("Unable to parse header block");
+      if (!header.has_bbox())
+        return true;
+
+      const auto &bbox = header.bbox();
+      return bbox_.intersects(utymap::BoundingBox(
+        GeoCoordinate(0.000000001*bbox.bottom(), 0.000000001*bbox.left()),
+        GeoCoordinate(0.000000001*bbox.top(), 0.000000001*bbox.right())));
+    }
 
-    if (!stream.read(buffer_.data(), sz))
-      throw std::domain_error("Unable to read blob from file");
+    std::vector<char> readBlob(const OSMPBF::BlobHeader &header) {
+      std::int32_t sz = header.datasize();
 
-    if (!blob.ParseFromArray(buffer_.data(), sz))
+      if (sz > MaxUncompressedBlobSize)
+        throw std::domain_error("Blob size is bigger then allowed");
+
+      std::vector<char> data(sz);
+      if (!stream_.read(data.data(), sz))
+        throw std::domain_error("Unable to read blob from file");
+
+      return data;
+    }
+
+    std::istream &stream_;
+    const utymap::BoundingBox bbox_;
+    const std::size_t capacity_;
+
+    std::deque<RawBlob> blobs_;
+    std::map<std::size_t, Block> blocks_;
+    std::size_t read_;
+    std::size_t visited_;
+    bool isRead_;
+    bool isStopped_;
+    std::exception_ptr error_;
+
+    std::mutex lock_;
+    std::condition_variable signal_;
+    std::vector<std::thread> threads_;
+  };
+
+  /// Reads uncompressed content of serialized blob.
+  static void readBlobContent(const std::vector<char> &data, std::string &raw) {
+    OSMPBF::Blob blob;
+    if (!blob.ParseFromArray(data.data(), static_cast<int>(data.size())))
       throw std::domain_error("Unable to parse blob");
 
     // uncompressed
     if (blob.has_raw()) {
-      sz = static_cast<std::int32_t>(blob.raw().size());
-      memcpy(unpack_buffer_.data(), buffer_.data(), sz);
-      return sz;
+      blob.mutable_raw()->swap(raw);
+      return;
     }
 
     if (blob.has_zlib_data()) {
-      sz = static_cast<std::int32_t>(blob.zlib_data().size());
+      if (blob.raw_size() > MaxUncompressedBlobSize)
+        throw std::domain_error("Blob size is bigger then allowed");
+
+      raw.resize(blob.raw_size());
 
       z_stream z;
       z.next_in = (unsigned char *) blob.zlib_data().c_str();
-      z.avail_in = sz;
-      z.next_out = reinterpret_cast<unsigned char *>(unpack_buffer_.data());
+      z.avail_in = static_cast<uInt>(blob.zlib_data().size());
+      z.next_out = reinterpret_cast<unsigned char *>(&raw[0]);
       z.avail_out = blob.raw_size();
       z.zalloc = Z_NULL;
       z.zfree = Z_NULL;
@@ -113,112 +424,116 @@ class OsmPbfParser final {
       if (inflateInit(&z)!=Z_OK)
         throw std::domain_error("Failed to init zlib stream");
 
-      if (inflate(&z, Z_FINISH)!=Z_STREAM_END)
+      if (inflate(&z, Z_FINISH)!=Z_STREAM_END) {
+        inflateEnd(&z);
         throw std::domain_error("Failed to inflate zlib stream");
+      }
 
       if (inflateEnd(&z)!=Z_OK)
         throw std::domain_error("Failed to deinit zlib stream");
 
-      return z.total_out;
+      raw.resize(z.total_out);
+      return;
     }
 
     if (blob.has_lzma_data())
       throw std::domain_error("Lzma-decompression is not supported");
 
-    return 0;
+    raw.clear();
   }
 
-  void parsePrimitiveBlock(int32_t sz, Visitor &visitor) {
+  /// Decodes block. Tags of elements keep indices of block strings.
+  static void decodePrimitiveBlock(const std::string &data,
+                                   const utymap::BoundingBox &bbox,
+                                   Block &block) {
     OSMPBF::PrimitiveBlock primblock;
+    bool isFiltered = bbox.isValid();
 
-    if (!primblock.ParseFromArray(unpack_buffer_.data(), sz))
+    if (!primblock.ParseFromString(data))
       throw std::domain_error("Unable to parse primitive block");
 
-    for (int i = 0, l = primblock.primitivegroup_size(); i < l; i++) {
-      OSMPBF::PrimitiveGroup pg = primblock.primitivegroup(i);
+    auto &strings = *primblock.mutable_stringtable()->mutable_s();
+    block.strings.resize(strings.size());
+    for (int i = 0; i < strings.size(); ++i)
+      block.strings[i].swap(*strings.Mutable(i));
+    auto stringCount = static_cast<std::uint32_t>(block.strings.size());
 
+    for (const auto &pg : primblock.primitivegroup()) {
       // simple nodes
-      for (int i = 0; i < pg.nodes_size(); ++i) {
-        OSMPBF::Node n = pg.nodes(i);
-        GeoCoordinate coordinate;
-        coordinate.latitude = 0.000000001*(primblock.lat_offset() + (primblock.granularity()*n.lat()));
-        coordinate.longitude = 0.000000001*(primblock.lon_offset() + (primblock.granularity()*n.lon()));
-        std::uint64_t id = n.id();
-        Tags tags;
-        setTags(n, primblock, tags);
-        visitor.visitNode(id, coordinate, tags);
+      for (const auto &n : pg.nodes()) {
+        Node node;
+        node.id = n.id();
+        node.coordinate.latitude = 0.000000001*(primblock.lat_offset() + (primblock.granularity()*n.lat()));
+        node.coordinate.longitude = 0.000000001*(primblock.lon_offset() + (primblock.granularity()*n.lon()));
+        if (!isFiltered || bbox.contains(node.coordinate))
+          setTags(n, stringCount, node.tags);
+        block.nodes.push_back(std::move(node));
       }
 
       // dense nodes
       if (pg.has_dense()) {
-        OSMPBF::DenseNodes dn = pg.dense();
+        const auto &dn = pg.dense();
         uint64_t id = 0;
         double lon = 0;
         double lat = 0;
 
         int current_kv = 0;
 
+        block.nodes.reserve(block.nodes.size() + dn.id_size());
         for (int i = 0; i < dn.id_size(); ++i) {
           id += dn.id(i);
           lat += 0.000000001*(primblock.lat_offset() + (primblock.granularity()*dn.lat(i)));
           lon += 0.000000001*(primblock.lon_offset() + (primblock.granularity()*dn.lon(i)));
 
-          Tags tags;
-          tags.reserve(2);
+          Node node;
+          node.id = id;
+          node.coordinate = GeoCoordinate(lat, lon);
+          bool isInside = !isFiltered || bbox.contains(node.coordinate);
           while (current_kv < dn.keys_vals_size() && dn.keys_vals(current_kv)!=0) {
-            auto key = dn.keys_vals(current_kv);
-            auto val = dn.keys_vals(current_kv + 1);
-            Tag tag;
-            tag.key = primblock.stringtable().s(key);
-            tag.value = primblock.stringtable().s(val);
+            if (isInside)
+              node.tags.push_back(createTag(dn.keys_vals(current_kv), dn.keys_vals(current_kv + 1), stringCount));
             current_kv += 2;
-            tags.push_back(tag);
           }
           ++current_kv;
-          GeoCoordinate coordinate(lat, lon);
-          visitor.visitNode(id, coordinate, tags);
+          block.nodes.push_back(std::move(node));
         }
       }
 
-      for (int i = 0; i < pg.ways_size(); ++i) {
-        OSMPBF::Way w = pg.ways(i);
+      for (const auto &w : pg.ways()) {
+        Way way;
+        way.id = w.id();
 
         uint64_t ref = 0;
-        std::vector<uint64_t> nodeIds;
-        nodeIds.reserve(w.refs_size());
-        for (int j = 0; j < w.refs_size(); ++j) {
-          ref += w.refs(j);
-          nodeIds.push_back(ref);
+        way.nodeIds.reserve(w.refs_size());
+        for (auto delta : w.refs()) {
+          ref += delta;
+          way.nodeIds.push_back(ref);
         }
-        uint64_t id = w.id();
-        Tags tags;
-        setTags(w, primblock, tags);
-        visitor.visitWay(id, nodeIds, tags);
+        setTags(w, stringCount, way.tags);
+        block.ways.push_back(std::move(way));
       }
 
-      for (int i = 0; i < pg.relations_size(); ++i) {
-        OSMPBF::Relation rel = pg.relations(i);
+      for (const auto &rel : pg.relations()) {
+        Relation relation;
+        relation.id = rel.id();
+
         uint64_t id = 0;
-        RelationMembers refs;
-        refs.reserve(rel.memids_size());
+        relation.members.reserve(rel.memids_size());
         for (int l = 0; l < rel.memids_size(); ++l) {
           id += rel.memids(l);
           RelationMember member;
           member.refId = id;
           member.type = parseType(rel, l);
-          member.role = primblock.stringtable().s(rel.roles_sid(l));
-          refs.push_back(member);
+          member.role = block.strings.at(rel.roles_sid(l));
+          relation.members.push_back(std::move(member));
         }
-
-        uint64_t rel_id = rel.id();
-        Tags tags;
-        setTags(rel, primblock, tags);
-        visitor.visitRelation(rel_id, refs, tags);
+        setTags(rel, stringCount, relation.tags);
+        block.relations.push_back(std::move(relation));
       }
     }
   }
 
-  static std::string parseType(OSMPBF::Relation &rel, int index) {
+  static std::string parseType(const OSMPBF::Relation &rel, int index) {
     switch (rel.types(index)) {
       case OSMPBF::Relation::NODE:return "n";
       case OSMPBF::Relation::WAY:return "w";
@@ -227,18 +542,23 @@ class OsmPbfParser final {
     }
   }
 
+  /// Sets tags using indices of block strings.
   template<typename T>
-  void setTags(const T &object, const OSMPBF::PrimitiveBlock &primblock, Tags &tags) {
+  static void setTags(const T &object, std::uint32_t stringCount, EntityTags &tags) {
     tags.reserve(object.keys_size());
-    for (int i = 0; i < object.keys_size(); ++i) {
-      Tag tag;
-      auto key = object.keys(i);
-      auto val = object.vals(i);
-      tag.key = primblock.stringtable().s(key);
-      tag.value = primblock.stringtable().s(val);
-      tags.push_back(tag);
-    }
+    for (int i = 0; i < object.keys_size(); ++i)
+      tags.push_back(createTag(object.keys(i), object.vals(i), stringCount));
   }
+
+  /// Creates tag which refers to block strings with given indices.
+  static utymap::entities::Tag createTag(std::uint32_t key, std::uint32_t value, std::uint32_t stringCount) {
+    if (key >= stringCount || value >= stringCount)
+      throw std::domain_error("Tag refers to unknown string of block.");
+    return utymap::entities::Tag(key, value);
+  }
+
+  const utymap::index::StringTable &stringTable_;
+  const std::size_t workers_;
 };
 
 }
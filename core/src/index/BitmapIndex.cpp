@@ -1,7 +1,9 @@
 #include "index/BitmapIndex.hpp"
 #include "utils/CoreUtils.hpp"
+#include "utils/GeoUtils.hpp"
 
-#include<boost/tokenizer.hpp>
+#include <algorithm>
+#include <stdexcept>
 
 using namespace utymap::entities;
 using namespace utymap::index;
@@ -9,91 +11,215 @@ using namespace utymap::index;
 namespace {
   using Bitset = BitmapIndex::Bitset;
   using Bitmap = BitmapIndex::Bitmap;
-  /// Defines symbols considered as token delimiters
-  const boost::char_separator<char> separator(" _:;!@#$%^&*(){}[],.?`\\/\"\'");
-
-  /// Applies logical operation
-  void applyOperation(const BitmapIndex::Ids &terms,
-                      const Bitmap &bitmap,
-                      const std::function<void(Bitset)> &op,
-                      const std::function<bool()> &noOp) {
-    for (const auto term: terms) {
-      auto array = bitmap.find(term);
-      // no term defined for this quad key
-      if (array == bitmap.end()) {
-        if (!noOp()) return;
+  using Ids = BitmapIndex::Ids;
+  /// Marks query term as prefix.
+  const char PrefixMarker = '*';
+  /// Defines logical operation which writes result into container.
+  using Operation = void (Bitset::*)(const Bitset &, Bitset &) const;
+
+  /// Replaces target with result of given operation applied to it and argument.
+  void apply(Bitset &target, const Bitset &argument, Bitset &buffer, Operation operation) {
+    buffer.reset();
+    (target.*operation)(argument, buffer);
+    target.swap(buffer);
+  }
+
+  /// Merges alternatives of all terms into single sorted list.
+  Ids flatten(const std::vector<Ids> &terms) {
+    Ids ids;
+    for (const auto &term : terms)
+      ids.insert(ids.end(), term.begin(), term.end());
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+  }
+
+  /// Gets upper bound of amount of tiles visited for bounding box at given level of details.
+  std::uint64_t getTileCount(const utymap::BoundingBox &bbox, int levelOfDetail) {
+    if (!bbox.isValid()) return 0;
+
+    auto start = utymap::utils::GeoUtils::GeoCoordinateToQuadKey(bbox.minPoint, levelOfDetail);
+    auto end = utymap::utils::GeoUtils::GeoCoordinateToQuadKey(bbox.maxPoint, levelOfDetail);
+    return static_cast<std::uint64_t>(end.tileX - start.tileX + 1) *
+           static_cast<std::uint64_t>(start.tileY - end.tileY + 1);
+  }
+
+  /// Calls action for bitsets of given sorted ids which are present in bitmap.
+  /// NOTE prefix term can be expanded to many tokens, so the smaller of ids and
+  /// bitmap is iterated: cost does not depend on vocabulary size.
+  template<typename Action>
+  void forEachBitset(const Bitmap &bitmap, const Ids &ids, const Action &action) {
+    if (ids.size() <= bitmap.size()) {
+      for (const auto id : ids) {
+        auto bitset = bitmap.find(id);
+        if (bitset != bitmap.end())
+          action(bitset->second);
       }
+      return;
+    }
+
+    for (const auto &pair : bitmap) {
+      if (std::binary_search(ids.begin(), ids.end(), pair.first))
+        action(pair.second);
+    }
+  }
+
+  /// Evaluates query over tile bitmap: union of OR terms intersected with all AND terms
+  /// except NOT ones. Each AND term is a union of its alternatives. AND terms are intersected
+  /// starting from the most selective one, so evaluation stops as soon as result is empty.
+  Bitset evaluate(const Bitmap &bitmap,
+                  const Ids &orTerms,
+                  const std::vector<Ids> &andTerms,
+                  const Ids &notTerms) {
+    Bitset result, buffer;
+    forEachBitset(bitmap, orTerms, [&](const Bitset &bitset) {
+      apply(result, bitset, buffer, &Bitset::logicalor);
+    });
+
+    std::vector<std::pair<std::size_t, const Bitset *>> postings;
+    std::vector<Bitset> unions(andTerms.size());
+    postings.reserve(andTerms.size());
+    for (std::size_t i = 0; i < andTerms.size(); ++i) {
+      const Bitset *posting = &unions[i];
+      forEachBitset(bitmap, andTerms[i], [&](const Bitset &bitset) {
+        if (andTerms[i].size() == 1)
+          posting = &bitset;
+        else
+          apply(unions[i], bitset, buffer, &Bitset::logicalor);
+      });
+      auto count = posting->numberOfOnes();
+      // no term defined for this quad key
+      if (count == 0)
+        return Bitset();
+      postings.emplace_back(count, posting);
+    }
+    std::sort(postings.begin(), postings.end());
+
+    for (const auto &posting : postings) {
+      if (result.sizeInBits() == 0)
+        result = *posting.second;
       else
-        op(array->second);
+        apply(result, *posting.second, buffer, &Bitset::logicaland);
+
+      if (result.numberOfOnes() == 0)
+        return Bitset();
     }
+
+    forEachBitset(bitmap, notTerms, [&](const Bitset &bitset) {
+      apply(result, bitset, buffer, &Bitset::logicalandnot);
+    });
+    return result;
   }
 }
 
 void BitmapIndex::add(const Element &element, const utymap::QuadKey &quadKey, const std::uint32_t order) {
-  auto& bitmap = getBitmap(quadKey);
+  add(element, order, getBitmap(quadKey));
+}
+
+void BitmapIndex::add(const Element &element, const std::uint32_t order, Bitmap &bitmap) {
   for (const auto &token : tokenize(element)) {
     bitmap[token].set(order);
   }
 }
 
 void BitmapIndex::search(const BitmapIndex::Query &query, ElementVisitor &visitor) {
-  Ids andTerms, orTerms, notTerms;
+  SearchPage page;
+  search(query, visitor, page);
+}
+
+void BitmapIndex::search(const BitmapIndex::Query &query, ElementVisitor &visitor, SearchPage &page) {
+  std::vector<Ids> andTerms, orTerms, notTerms;
   tokenize(query.andTerms, andTerms);
   tokenize(query.orTerms, orTerms);
   tokenize(query.notTerms, notTerms);
+  auto orIds = flatten(orTerms);
+  auto notIds = flatten(notTerms);
+
+  // NOTE position of limited page is packed into continuation token, so query
+  // which cannot be represented by it is rejected before any element is visited.
+  for (int lod = query.range.start; lod <= query.range.end && page.isLimited(); ++lod) {
+    if (getTileCount(query.boundingBox, lod) > SearchPage::MaxTileCount)
+      throw std::domain_error("Bounding box has too many tiles for paged search.");
+  }
 
-  for (int lod = query.range.start; lod <= query.range.end; ++lod) {
+
+  for (int lod = query.range.start; lod <= query.range.end && !page.isFull(); ++lod) {
     utymap::utils::GeoUtils::visitTileRange(query.boundingBox, lod,
       [&](const QuadKey &quadKey, const BoundingBox&) {
-        if (!hasData(quadKey)) return;
+        if (page.isFull() || !page.enterTile(quadKey) || !hasData(quadKey)) return;
 
-        auto& bitmap = getBitmap(quadKey);
         Bitset bitset;
-
-        applyOperation(orTerms, bitmap, [&](const Bitset &b) {
-          bitset = b.logicalor(bitset);
-        }, [](){ return true; });
-
-        applyOperation(andTerms, bitmap, [&](const Bitset &b) {
-          if (bitset.sizeInBits() == 0) {
-            bitset = b;
-            return;
-          }
-          bitset = b.logicaland(bitset);
-        }, [&]() {
-          bitset.reset();
-          return false;
+        readBitmap(quadKey, [&](const Bitmap &bitmap) {
+          bitset = evaluate(bitmap, orIds, andTerms, notIds);
         });
 
-        applyOperation(notTerms, bitmap, [&](const Bitset &b) {
-          bitset = b.logicalxor(bitset).logicaland(bitset);
-        }, [](){ return true; });
-
+        Ids orders;
+        auto firstOrder = page.firstOrder();
         for (auto i = bitset.begin(); i != bitset.end(); ++i) {
-          notify(quadKey, static_cast<std::uint32_t >(*i), visitor);
+          if (*i >= firstOrder)
+            orders.push_back(static_cast<std::uint32_t>(*i));
+        }
+        if (orders.empty()) return;
+
+        filterByBounds(quadKey, query.boundingBox, orders);
+        std::vector<ElementKey> keys;
+        getElementKeys(quadKey, orders, keys);
+        page.reserve(orders.size());
+        for (std::size_t i = 0; i < orders.size() && !page.isFull(); ++i) {
+          if (i < keys.size() && page.isVisited(keys[i])) continue;
+          page.moveTo(orders[i]);
+          notify(quadKey, orders[i], visitor);
         }
       });
   }
 }
 
 std::vector<std::uint32_t> BitmapIndex::tokenize(const Element &element) {
-  Ids tokens;
-  tokens.reserve(element.tags.size() * 2 + 4);
+  Ids ids;
+  ids.reserve(element.tags.size() * 2);
   for (const auto &tag : element.tags) {
-    auto key = stringTable_.getString(tag.key);
-    auto value = stringTable_.getString(tag.value);
-    tokenize(*key, tokens);
-    tokenize(*value, tokens);
+    stringTable_.getTokenIds(tag.key, ids);
+    stringTable_.getTokenIds(tag.value, ids);
   }
-  return tokens;
+  return ids;
 }
 
 void BitmapIndex::tokenize(const std::string &source,
-                           Ids &destination) {
-  boost::tokenizer<boost::char_separator<char>> tokens(source, separator);
-  for (const auto& token : tokens) {
-    destination.push_back(stringTable_.getId(token));
+                           std::vector<Ids> &terms) {
+  std::vector<std::string> tokens;
+  StringTable::tokenize(source, tokens);
+
+  // NOTE tokens are found in source sequentially as they cannot contain separators.
+  std::vector<std::string> exactTokens;
+  std::vector<std::size_t> exactTerms;
+  std::size_t position = 0;
+  for (const auto &token : tokens) {
+    position = source.find(token, position) + token.size();
+    terms.push_back(Ids());
+    if (position < source.size() && source[position] == PrefixMarker) {
+      stringTable_.getPrefixIds(token, terms.back());
+    } else {
+      exactTokens.push_back(token);
+      exactTerms.push_back(terms.size() - 1);
+    }
   }
+
+  Ids ids;
+  getIds(exactTokens, ids);
+  for (std::size_t i = 0; i < ids.size(); ++i)
+    terms[exactTerms[i]].push_back(ids[i]);
+
+  // NOTE alternatives are searched in bitmap by binary search.
+  for (auto &term : terms)
+    std::sort(term.begin(), term.end());
+}
+
+void BitmapIndex::getIds(const std::vector<std::string> &tokens, Ids &ids) const {
+  std::vector<const std::string *> strings;
+  strings.reserve(tokens.size());
+  for (const auto &token : tokens)
+    strings.push_back(&token);
+  stringTable_.getIds(strings, ids);
 }
 
 BitmapIndex::BitmapIndex(const StringTable &stringTable) :
@@ -5,22 +5,25 @@
 #include "LodRange.hpp"
 #include "StringTable.hpp"
 #include "QuadKey.hpp"
+#include "SearchPage.hpp"
 #include "entities/Element.hpp"
 
 #include <ewah/ewah.h>
+#include <functional>
 #include <unordered_map>
 
 namespace utymap {
 namespace index {
 
-/// Provides the way to index strings in order to perform fast exact search.
+/// Provides the way to index strings in order to perform fast exact or prefix search.
 class BitmapIndex {
  public:
   using Bitset = EWAHBoolArray<std::uint32_t>;
   using Bitmap = std::unordered_map<std::uint32_t, Bitset>;
   using Ids = std::vector<std::uint32_t>;
 
-  /// Defines query to indexed string data.
+  /// Defines query to indexed string data. Term followed by '*' matches
+  /// all tokens starting with it, e.g. "bran*" matches "brandenburger".
   struct Query {
     /// Logical "not": result should not include any of these terms.
     std::string notTerms;
@@ -47,10 +50,21 @@ class BitmapIndex {
   void search(const Query &query,
               utymap::entities::ElementVisitor &visitor);
 
+  /// Performs search for relevant data match query starting from page position.
+  /// Iteration stops as soon as page is full.
+  void search(const Query &query,
+              utymap::entities::ElementVisitor &visitor,
+              utymap::index::SearchPage &page);
+
   /// Erases all data from given quad key.
   virtual void erase(const utymap::QuadKey &quadKey) = 0;
 
  protected:
+  /// Adds element with given store order into given bitmap.
+  void add(const utymap::entities::Element &element,
+           const std::uint32_t order,
+           Bitmap &bitmap);
+
   /// Notifies that element with given store order id
   /// should be visited with visitor.
   virtual void notify(const utymap::QuadKey& quadKey,
@@ -60,15 +74,35 @@ class BitmapIndex {
   /// Get bitmap for given quad key.
   virtual Bitmap& getBitmap(const utymap::QuadKey& quadKey) = 0;
 
+  /// Calls action with bitmap of given quad key. Can be overridden
+  /// in order to synchronize search with concurrent modifications.
+  virtual void readBitmap(const utymap::QuadKey& quadKey,
+                          const std::function<void(const Bitmap&)> &action) {
+    action(getBitmap(quadKey));
+  }
+
   /// Checks whether data exist for given quad key.
   virtual bool hasData(const utymap::QuadKey& quadKey) const = 0;
 
+  /// Gets keys of elements with given orders, so elements which are already visited
+  /// are skipped before they are read. Kind of element is unknown by default, so
+  /// duplicates are skipped only after they are read.
+  virtual void getElementKeys(const utymap::QuadKey &quadKey, const Ids &orders,
+                              std::vector<ElementKey> &keys) {}
+
+  /// Removes orders of elements which do not intersect given bounding box.
+  /// By default, all elements are kept and checked when they are read.
+  virtual void filterByBounds(const utymap::QuadKey &quadKey, const utymap::BoundingBox &bbox, Ids &orders) {}
+
  private:
   /// Gets tokens from element.
   std::vector<std::uint32_t> tokenize(const utymap::entities::Element &element);
 
-  /// Stores tokens received from source into destination.
-  void tokenize(const std::string &str, Ids &destination);
+  /// Stores ids of terms received from source: each term is list of alternative token ids.
+  void tokenize(const std::string &str, std::vector<Ids> &terms);
+
+  /// Gets ids of given tokens in one string table batch.
+  void getIds(const std::vector<std::string> &tokens, Ids &ids) const;
 
   const StringTable& stringTable_;
 };
@@ -0,0 +1,21 @@
+#ifndef INDEX_ELEMENTKEY_HPP_DEFINED
+#define INDEX_ELEMENTKEY_HPP_DEFINED
+
+#include <cstdint>
+
+namespace utymap {
+namespace index {
+
+/// Defines kind of element: element ids are unique only among elements of the same kind.
+enum class ElementKind : std::uint8_t { Node, Way, Area, Relation, Unknown };
+
+/// Identifies element regardless of tile and level of details it is stored in.
+struct ElementKey {
+  std::uint64_t id;
+  ElementKind kind;
+};
+
+}
+}
+
+#endif // INDEX_ELEMENTKEY_HPP_DEFINED
@@ -28,6 +28,17 @@ ElementStore::ElementStore(const StringTable &stringTable) :
     skipKeyId_(stringTable.getId(StyleConsts::SkipKey())) {
 }
 
+void ElementStore::search(const std::string &notTerms,
+                          const std::string &andTerms,
+                          const std::string &orTerms,
+                          const utymap::BoundingBox &bbox,
+                          const utymap::LodRange &range,
+                          ElementVisitor &visitor,
+                          const utymap::CancellationToken &cancelToken) {
+  SearchPage page;
+  search(notTerms, andTerms, orTerms, bbox, range, visitor, page, cancelToken);
+}
+
 bool ElementStore::store(const Element &element, const utymap::LodRange &range, const StyleProvider &styleProvider) {
   return store(element, range, styleProvider, [&](const BoundingBox &, const BoundingBox &) {
     return true;
@@ -5,6 +5,7 @@
 #include "CancellationToken.hpp"
 #include "LodRange.hpp"
 #include "QuadKey.hpp"
+#include "SearchPage.hpp"
 #include "entities/Element.hpp"
 #include "entities/ElementVisitor.hpp"
 #include "mapcss/StyleProvider.hpp"
@@ -19,15 +20,26 @@ class ElementStore {
 
   virtual ~ElementStore() = default;
 
-  /// Searches for elements matches given query, bounding box and LOD range
+  /// Searches for elements matches given query, bounding box and LOD range.
+  /// Only elements of given page are visited.
   virtual void search(const std::string &notTerms,
                       const std::string &andTerms,
                       const std::string &orTerms,
                       const utymap::BoundingBox &bbox,
                       const utymap::LodRange &range,
                       utymap::entities::ElementVisitor &visitor,
+                      utymap::index::SearchPage &page,
                       const utymap::CancellationToken &cancelToken) = 0;
 
+  /// Searches for all elements matches given query, bounding box and LOD range.
+  void search(const std::string &notTerms,
+              const std::string &andTerms,
+              const std::string &orTerms,
+              const utymap::BoundingBox &bbox,
+              const utymap::LodRange &range,
+              utymap::entities::ElementVisitor &visitor,
+              const utymap::CancellationToken &cancelToken);
+
   /// Searches for elements for given quadKey
   virtual void search(const utymap::QuadKey &quadKey,
                       utymap::entities::ElementVisitor &visitor,
@@ -52,6 +64,16 @@ class ElementStore {
              const utymap::LodRange &range,
              const utymap::mapcss::StyleProvider &styleProvider);
 
+  /// Starts bulk load transaction: store may buffer all saved elements until commit.
+  /// Default implementation writes elements immediately.
+  virtual void begin() {}
+
+  /// Commits bulk load transaction making all elements saved since begin visible.
+  virtual void commit() {}
+
+  /// Discards all elements saved since begin without affecting data stored before.
+  virtual void rollback() {}
+
   /// Saves element in given quadkey.
   virtual void save(const utymap::entities::Element &element,
                     const utymap::QuadKey &quadKey) = 0;
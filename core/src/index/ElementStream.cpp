@@ -6,6 +6,9 @@
 #include "index/ElementStream.hpp"
 #include "utils/CoreUtils.hpp"
 
+#include <cmath>
+#include <cstring>
+
 using namespace utymap;
 using namespace utymap::entities;
 using namespace utymap::index;
@@ -17,126 +20,272 @@ const char WayType = 1;
 const char AreaType = 2;
 const char RelationType = 3;
 
-std::ostream &operator<<(std::ostream &stream, const Tag &tag) {
-  stream.write(reinterpret_cast<const char *>(&tag.key), sizeof(tag.key));
-  stream.write(reinterpret_cast<const char *>(&tag.value), sizeof(tag.value));
-  return stream;
-}
-
-std::istream &operator>>(std::istream &stream, Tag &tag) {
-  stream.read(reinterpret_cast<char *>(&tag.key), sizeof(tag.key));
-  stream.read(reinterpret_cast<char *>(&tag.value), sizeof(tag.value));
-  return stream;
-}
-
-std::ostream &operator<<(std::ostream &stream, const utymap::GeoCoordinate &coordinate) {
-  stream.write(reinterpret_cast<const char *>(&coordinate.latitude), sizeof(coordinate.latitude));
-  stream.write(reinterpret_cast<const char *>(&coordinate.longitude), sizeof(coordinate.longitude));
-  return stream;
-}
+/// Marks element header of v2 format: element type is stored in lower bits.
+/// NOTE elements of v1 format start with element type only.
+const char Version2 = 0x20;
+const char VersionMask = 0x70;
+const char TypeMask = 0x0F;
 
-std::istream &operator>>(std::istream &stream, utymap::GeoCoordinate &coordinate) {
-  stream.read(reinterpret_cast<char *>(&coordinate.latitude), sizeof(coordinate.latitude));
-  stream.read(reinterpret_cast<char *>(&coordinate.longitude), sizeof(coordinate.longitude));
-  return stream;
-}
+/// Scale of fixed point coordinates.
+const double Scale = 1E7;
 
-template<typename T>
-std::ostream &operator<<(std::ostream &stream, const std::vector<T> &data) {
-  std::uint16_t size = static_cast<std::uint16_t>(data.size());
-  stream.write(reinterpret_cast<const char *>(&size), sizeof(size));
-  for (const auto &item : data)
-    stream << item;
-  return stream;
+std::int32_t toFixed(double value) {
+  return static_cast<std::int32_t>(std::llround(value * Scale));
 }
 
-template<typename T>
-std::istream &operator>>(std::istream &stream, std::vector<T> &data) {
-  std::uint16_t size = 0;
-  stream.read(reinterpret_cast<char *>(&size), sizeof(size));
-  data.resize(size);
-  for (size_t i = 0; i < size; ++i)
-    stream >> data[i];
-  return stream;
+double fromFixed(std::int64_t value) {
+  return static_cast<double>(value) / Scale;
 }
 
-/// Writes element to stream.
+/// Writes element to stream using v2 format: varint ids and sizes,
+/// zig-zag varint deltas of fixed point coordinates.
 struct ElementWriter : ElementVisitor {
   explicit ElementWriter(std::ostream &s) : stream_(s) {}
 
   void visitNode(const Node &node) override {
-    stream_ << NodeType << node.tags << node.coordinate;
+    writeHeader(NodeType);
+    writeTags(node.tags);
+    writeSigned(toFixed(node.coordinate.latitude));
+    writeSigned(toFixed(node.coordinate.longitude));
   }
 
   void visitWay(const Way &way) override {
-    stream_ << WayType << way.tags << way.coordinates;
+    writeHeader(WayType);
+    writeTags(way.tags);
+    writeCoordinates(way.coordinates);
   }
 
   void visitArea(const Area &area) override {
-    stream_ << AreaType << area.tags << area.coordinates;
+    writeHeader(AreaType);
+    writeTags(area.tags);
+    writeCoordinates(area.coordinates);
   }
 
   void visitRelation(const Relation &relation) override {
-    stream_ << RelationType << relation.tags;
-    auto size = static_cast<std::uint16_t>(relation.elements.size());
-    stream_.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    writeHeader(RelationType);
+    writeTags(relation.tags);
+    writeVarint(relation.elements.size());
     for (const auto &element : relation.elements) {
-      stream_.write(reinterpret_cast<const char *>(&element->id), sizeof(element->id));
+      writeVarint(element->id);
       element->accept(*this);
     }
   }
 
+ private:
+  void writeHeader(char type) {
+    stream_.put(Version2 | type);
+  }
+
+  void writeTags(const std::vector<Tag> &tags) {
+    writeVarint(tags.size());
+    for (const auto &tag : tags) {
+      writeVarint(tag.key);
+      writeVarint(tag.value);
+    }
+  }
+
+  void writeCoordinates(const std::vector<GeoCoordinate> &coordinates) {
+    writeVarint(coordinates.size());
+    std::int64_t latitude = 0, longitude = 0;
+    for (const auto &coordinate : coordinates) {
+      std::int64_t nextLatitude = toFixed(coordinate.latitude);
+      std::int64_t nextLongitude = toFixed(coordinate.longitude);
+      writeSigned(nextLatitude - latitude);
+      writeSigned(nextLongitude - longitude);
+      latitude = nextLatitude;
+      longitude = nextLongitude;
+    }
+  }
+
+  void writeSigned(std::int64_t value) {
+    writeVarint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+  }
+
+  void writeVarint(std::uint64_t value) {
+    while (value >= 0x80) {
+      stream_.put(static_cast<char>(value | 0x80));
+      value >>= 7;
+    }
+    stream_.put(static_cast<char>(value));
+  }
+
   std::ostream &stream_;
 };
 
-/// Reads element from stream.
+/// Provides access to element data stored in input stream.
+class StreamSource final {
+ public:
+  explicit StreamSource(std::istream &stream) : stream_(stream) {
+  }
+
+  void read(char *destination, std::size_t size) {
+    stream_.read(destination, size);
+  }
+
+ private:
+  std::istream &stream_;
+};
+
+/// Provides access to element data stored in memory buffer, e.g. in memory mapped file.
+class MemorySource final {
+ public:
+  MemorySource(const char *data, std::size_t size) : current_(data), end_(data + size) {
+  }
+
+  void read(char *destination, std::size_t size) {
+    if (current_ + size > end_)
+      throw std::domain_error("Unexpected end of element data.");
+    std::memcpy(destination, current_, size);
+    current_ += size;
+  }
+
+ private:
+  const char *current_;
+  const char *end_;
+};
+
+/// Reads element from source.
+template<typename Source>
 class ElementReader final {
  public:
-  explicit ElementReader(std::istream &stream) : stream_(stream) {
+  explicit ElementReader(Source &source) : source_(source) {
   }
 
-  std::unique_ptr<Element> read() const {
-    char elementType;
-    stream_ >> elementType;
+  std::unique_ptr<Element> read() {
+    char header;
+    readValue(header);
 
-    switch (elementType) {
-      case NodeType:return readNode();
-      case WayType:return readWay();
-      case AreaType:return readArea();
-      case RelationType:return readRelation();
+    bool isCompact = (header & VersionMask) == Version2;
+    switch (isCompact ? header & TypeMask : header) {
+      case NodeType:return readNode(isCompact);
+      case WayType:return readWay(isCompact);
+      case AreaType:return readArea(isCompact);
+      case RelationType:return readRelation(isCompact);
       default:throw std::domain_error("Unknown element type.");
     }
   }
 
  private:
-  std::unique_ptr<Node> readNode() const {
+  template<typename T>
+  void readValue(T &value) {
+    source_.read(reinterpret_cast<char *>(&value), sizeof(value));
+  }
+
+  void readValue(Tag &tag) {
+    readValue(tag.key);
+    readValue(tag.value);
+  }
+
+  void readValue(GeoCoordinate &coordinate) {
+    readValue(coordinate.latitude);
+    readValue(coordinate.longitude);
+  }
+
+  template<typename T>
+  void readValue(std::vector<T> &data) {
+    std::uint16_t size = 0;
+    readValue(size);
+    data.resize(size);
+    for (std::size_t i = 0; i < size; ++i)
+      readValue(data[i]);
+  }
+
+  std::uint64_t readVarint() {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      std::uint8_t byte = 0;
+      readValue(byte);
+      value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0)
+        return value;
+    }
+    throw std::domain_error("Malformed varint in element data.");
+  }
+
+  std::int64_t readSigned() {
+    auto value = readVarint();
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+  }
+
+  void readTags(std::vector<Tag> &tags, bool isCompact) {
+    if (!isCompact) {
+      readValue(tags);
+      return;
+    }
+
+    tags.resize(readVarint());
+    for (auto &tag : tags) {
+      tag.key = static_cast<std::uint32_t>(readVarint());
+      tag.value = static_cast<std::uint32_t>(readVarint());
+    }
+  }
+
+  void readCoordinate(GeoCoordinate &coordinate, bool isCompact) {
+    if (!isCompact) {
+      readValue(coordinate);
+      return;
+    }
+
+    coordinate.latitude = fromFixed(readSigned());
+    coordinate.longitude = fromFixed(readSigned());
+  }
+
+  void readCoordinates(std::vector<GeoCoordinate> &coordinates, bool isCompact) {
+    if (!isCompact) {
+      readValue(coordinates);
+      return;
+    }
+
+    coordinates.resize(readVarint());
+    std::int64_t latitude = 0, longitude = 0;
+    for (auto &coordinate : coordinates) {
+      latitude += readSigned();
+      longitude += readSigned();
+      coordinate.latitude = fromFixed(latitude);
+      coordinate.longitude = fromFixed(longitude);
+    }
+  }
+
+  std::unique_ptr<Node> readNode(bool isCompact) {
     auto node = utymap::utils::make_unique<Node>();
-    stream_ >> node->tags >> node->coordinate;
+    readTags(node->tags, isCompact);
+    readCoordinate(node->coordinate, isCompact);
     return std::move(node);
   }
 
-  std::unique_ptr<Way> readWay() const {
+  std::unique_ptr<Way> readWay(bool isCompact) {
     auto way = utymap::utils::make_unique<Way>();
-    stream_ >> way->tags >> way->coordinates;
+    readTags(way->tags, isCompact);
+    readCoordinates(way->coordinates, isCompact);
     return std::move(way);
   }
 
-  std::unique_ptr<Area> readArea() const {
+  std::unique_ptr<Area> readArea(bool isCompact) {
     auto area = utymap::utils::make_unique<Area>();
-    stream_ >> area->tags >> area->coordinates;
+    readTags(area->tags, isCompact);
+    readCoordinates(area->coordinates, isCompact);
     return std::move(area);
   }
 
-  std::unique_ptr<Relation> readRelation() const {
+  std::unique_ptr<Relation> readRelation(bool isCompact) {
     auto relation = utymap::utils::make_unique<Relation>();
-    stream_ >> relation->tags;
+    readTags(relation->tags, isCompact);
 
-    std::uint16_t elementSize = 0;
-    stream_.read(reinterpret_cast<char *>(&elementSize), sizeof(elementSize));
+    std::uint64_t elementSize = 0;
+    if (isCompact) {
+      elementSize = readVarint();
+    } else {
+      std::uint16_t size = 0;
+      readValue(size);
+      elementSize = size;
+    }
 
-    for (std::uint16_t i = 0; i < elementSize; ++i) {
+    for (std::uint64_t i = 0; i < elementSize; ++i) {
       std::uint64_t id;
-      stream_.read(reinterpret_cast<char *>(&id), sizeof(id));
+      if (isCompact)
+        id = readVarint();
+      else
+        readValue(id);
       auto element = read();
       element->id = id;
       relation->elements.push_back(std::move(element));
@@ -144,16 +293,40 @@ class ElementReader final {
     return relation;
   }
 
-  std::istream &stream_;
+  Source &source_;
 };
-}
 
-std::unique_ptr<utymap::entities::Element> ElementStream::read(std::istream &stream, std::uint64_t id) {
-  auto reader = ElementReader(stream);
-  auto element = reader.read();
+template<typename Source>
+std::unique_ptr<Element> readElement(Source &source, std::uint64_t id) {
+  auto element = ElementReader<Source>(source).read();
   element->id = id;
   return element;
 }
+}
+
+std::unique_ptr<utymap::entities::Element> ElementStream::read(std::istream &stream, std::uint64_t id) {
+  StreamSource source(stream);
+  return readElement(source, id);
+}
+
+std::unique_ptr<utymap::entities::Element> ElementStream::read(const char *data, std::size_t size, std::uint64_t id) {
+  MemorySource source(data, size);
+  return readElement(source, id);
+}
+
+ElementKind ElementStream::readKind(const char *data, std::size_t size) {
+  if (size == 0)
+    return ElementKind::Unknown;
+
+  char header = data[0];
+  switch ((header & VersionMask) == Version2 ? header & TypeMask : header) {
+    case NodeType:return ElementKind::Node;
+    case WayType:return ElementKind::Way;
+    case AreaType:return ElementKind::Area;
+    case RelationType:return ElementKind::Relation;
+    default:return ElementKind::Unknown;
+  }
+}
 
 void ElementStream::write(std::ostream &stream, const utymap::entities::Element &element) {
   auto writer = ElementWriter(stream);
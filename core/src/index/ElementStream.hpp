@@ -2,18 +2,28 @@
 #define INDEX_ELEMENTSTREAM_HPP_DEFINED
 
 #include "entities/Element.hpp"
+#include "index/ElementKey.hpp"
 
+#include <cstddef>
 #include <memory>
 #include <iostream>
 
 namespace utymap {
 namespace index {
 
+/// Reads and writes elements in binary format. Elements are written in compact v2
+/// format with fixed point coordinates (1E-7 degree precision), v1 format is still readable.
 class ElementStream final {
  public:
   /// Reads element with given id from input stream.
   static std::unique_ptr<utymap::entities::Element> read(std::istream &stream, std::uint64_t id);
 
+  /// Reads element with given id from memory buffer of given size.
+  static std::unique_ptr<utymap::entities::Element> read(const char *data, std::size_t size, std::uint64_t id);
+
+  /// Reads kind of element from memory buffer without reading element itself.
+  static ElementKind readKind(const char *data, std::size_t size);
+
   /// Writes element to output stream.
   static void write(std::ostream &stream, const utymap::entities::Element &element);
 };
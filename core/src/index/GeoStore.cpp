@@ -1,7 +1,12 @@
+#include "entities/Area.hpp"
 #include "entities/Element.hpp"
+#include "entities/Node.hpp"
+#include "entities/Relation.hpp"
+#include "entities/Way.hpp"
 #include "LodRange.hpp"
 #include "formats/shape/ShapeDataVisitor.hpp"
 #include "formats/shape/ShapeParser.hpp"
+#include "formats/osm/NodeLocationStore.hpp"
 #include "formats/osm/json/OsmJsonParser.hpp"
 #include "formats/osm/xml/OsmXmlParser.hpp"
 #ifdef PBF_SUPPORTED_ENABLED
@@ -10,16 +15,224 @@
 #include "index/GeoStore.hpp"
 #include "index/InMemoryElementStore.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
 using namespace utymap::entities;
 using namespace utymap::formats;
 using namespace utymap::index;
 using namespace utymap::mapcss;
 
+namespace {
+/// Amount of elements collected by worker before they are passed to calling thread.
+const std::size_t CollectorBatchSize = 64;
+/// Amount of batches which can wait for calling thread.
+const std::size_t MaxQueuedBatches = 16;
+
+/// Size of osm file starting from which node locations are kept in memory mapped file.
+const std::streamoff DenseLocationsFileSize = 256 * 1024 * 1024;
+
+/// Creates store for node locations which fits size of given osm file.
+std::unique_ptr<NodeLocationStore> createNodeLocationStore(const std::string &path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+  if (file.good() && file.tellg() >= DenseLocationsFileSize)
+    return utymap::utils::make_unique<DenseNodeLocationStore>();
+  return utymap::utils::make_unique<SparseNodeLocationStore>();
+}
+
+/// Runs tasks on fixed amount of background threads.
+class WorkerPool final {
+ public:
+  explicit WorkerPool(std::size_t size) : tasks_(), lock_(), signal_(), isStopped_(false), threads_() {
+    for (std::size_t i = 0; i < size; ++i)
+      threads_.emplace_back(&WorkerPool::run, this);
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      isStopped_ = true;
+    }
+    signal_.notify_all();
+    for (auto &thread : threads_)
+      thread.join();
+  }
+
+  /// Schedules task which should not throw.
+  void schedule(const std::function<void()> &task) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      tasks_.push_back(task);
+    }
+    signal_.notify_one();
+  }
+
+ private:
+  void run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(lock_);
+        signal_.wait(lock, [&]() { return isStopped_ || !tasks_.empty(); });
+        if (tasks_.empty()) return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::deque<std::function<void()>> tasks_;
+  std::mutex lock_;
+  std::condition_variable signal_;
+  bool isStopped_;
+  std::vector<std::thread> threads_;
+};
+
+/// Searches stores in parallel on worker pool. Elements found by workers are copied
+/// and passed in batches through bounded queue to calling thread which visits them,
+/// so visitor is called on calling thread only. Workers wait while queue is full.
+class StoreFanOut final {
+ public:
+  using Search = std::function<void(ElementStore &, ElementVisitor &)>;
+  /// Decides whether found element should be visited. Called on calling thread.
+  using Filter = std::function<bool(const Element &)>;
+
+  StoreFanOut(WorkerPool &workers,
+              const std::vector<ElementStore *> &stores,
+              const Search &search,
+              const Filter &filter) :
+      workers_(workers), stores_(stores), search_(search), filter_(filter),
+      batches_(), lock_(), signal_(), pending_(0), error_(), isStopped_(false) {}
+
+  StoreFanOut(const StoreFanOut &) = delete;
+  StoreFanOut &operator=(const StoreFanOut &) = delete;
+
+  /// NOTE workers reference this object.
+  ~StoreFanOut() {
+    std::unique_lock<std::mutex> lock(lock_);
+    isStopped_ = true;
+    signal_.notify_all();
+    signal_.wait(lock, [&]() { return pending_ == 0; });
+  }
+
+  void run(ElementVisitor &visitor) {
+    pending_ = stores_.size();
+    for (std::size_t i = 0; i < stores_.size(); ++i)
+      workers_.schedule([this, i]() { collect(i); });
+
+    Batch batch;
+    while (take(batch)) {
+      for (const auto &element : batch) {
+        if (!filter_ || filter_(*element))
+          element->accept(visitor);
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+
+ private:
+  using Batch = std::vector<std::shared_ptr<const Element>>;
+
+  /// Copies visited elements and passes them to calling thread in batches.
+  class Collector final : public ElementVisitor {
+   public:
+    explicit Collector(StoreFanOut &fanOut) : fanOut_(fanOut), batch_() {}
+
+    void visitNode(const Node &node) override { add(std::make_shared<Node>(node)); }
+    void visitWay(const Way &way) override { add(std::make_shared<Way>(way)); }
+    void visitArea(const Area &area) override { add(std::make_shared<Area>(area)); }
+    void visitRelation(const Relation &relation) override { add(std::make_shared<Relation>(relation)); }
+
+    void flush() {
+      if (!batch_.empty())
+        fanOut_.put(std::move(batch_));
+      batch_.clear();
+    }
+
+   private:
+    void add(std::shared_ptr<const Element> element) {
+      if (fanOut_.isStopped_) return;
+      batch_.push_back(std::move(element));
+      if (batch_.size() >= CollectorBatchSize)
+        flush();
+    }
+
+    StoreFanOut &fanOut_;
+    Batch batch_;
+  };
+
+  /// Searches store with given index on worker thread.
+  void collect(std::size_t index) {
+    std::exception_ptr error;
+    try {
+      Collector collector(*this);
+      search_(*stores_[index], collector);
+      collector.flush();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (error && !error_) {
+      error_ = error;
+      isStopped_ = true;
+    }
+    --pending_;
+    signal_.notify_all();
+  }
+
+  /// Adds batch to queue waiting while queue is full. Batch is dropped if fan-out is stopped.
+  void put(Batch &&batch) {
+    std::unique_lock<std::mutex> lock(lock_);
+    signal_.wait(lock, [&]() { return isStopped_ || batches_.size() < MaxQueuedBatches; });
+    if (isStopped_) return;
+    batches_.push_back(std::move(batch));
+    signal_.notify_all();
+  }
+
+  /// Takes the next batch. Returns false when all workers are done or one of them has failed.
+  bool take(Batch &batch) {
+    std::unique_lock<std::mutex> lock(lock_);
+    signal_.wait(lock, [&]() { return isStopped_ || !batches_.empty() || pending_ == 0; });
+    if (isStopped_ || batches_.empty())
+      return false;
+    batch = std::move(batches_.front());
+    batches_.pop_front();
+    signal_.notify_all();
+    return true;
+  }
+
+  WorkerPool &workers_;
+  const std::vector<ElementStore *> &stores_;
+  const Search &search_;
+  const Filter &filter_;
+
+  std::deque<Batch> batches_;
+  std::mutex lock_;
+  std::condition_variable signal_;
+  std::size_t pending_;
+  std::exception_ptr error_;
+  std::atomic<bool> isStopped_;
+};
+}
+
 class GeoStore::GeoStoreImpl final {
  public:
 
   explicit GeoStoreImpl(const StringTable &stringTable) :
-      stringTable_(stringTable) {
+      stringTable_(stringTable), workers_(), workersFlag_() {
   }
 
   void registerStore(const std::string &storeKey, std::unique_ptr<ElementStore> store) {
@@ -41,12 +254,13 @@ class GeoStore::GeoStoreImpl final {
            const StyleProvider &styleProvider,
            const utymap::CancellationToken &cancelToken) {
     auto &elementStore = storeMap_[storeKey];
-    add(path, cancelToken, [&](Element &element) {
-      return elementStore->store(element, quadKey, styleProvider);
+    bulkLoad(*elementStore, cancelToken, [&]() {
+      // NOTE elements which cover tile without having nodes inside it should be clipped
+      // by element store, so data is not filtered by tile bounding box while parsed.
+      add(path, BoundingBox(), cancelToken, [&](Element &element) {
+        return elementStore->store(element, quadKey, styleProvider);
+      });
     });
-
-    if (cancelToken.isCancelled()) 
-      elementStore->erase(quadKey);
   }
 
   void add(const std::string &storeKey,
@@ -55,12 +269,11 @@ class GeoStore::GeoStoreImpl final {
            const StyleProvider &styleProvider,
            const utymap::CancellationToken &cancelToken) {
     auto &elementStore = storeMap_[storeKey];
-    auto bbox = add(path, cancelToken, [&](Element &element) {
-      return elementStore->store(element, range, styleProvider);
+    bulkLoad(*elementStore, cancelToken, [&]() {
+      add(path, BoundingBox(), cancelToken, [&](Element &element) {
+        return elementStore->store(element, range, styleProvider);
+      });
     });
-
-    if (cancelToken.isCancelled())
-      elementStore->erase(bbox, range);
   }
 
   void add(const std::string &storeKey,
@@ -70,15 +283,16 @@ class GeoStore::GeoStoreImpl final {
            const StyleProvider &styleProvider,
            const utymap::CancellationToken &cancelToken) {
     auto &elementStore = storeMap_[storeKey];
-    add(path, cancelToken, [&](Element &element) {
-      return elementStore->store(element, bbox, range, styleProvider);
+    bulkLoad(*elementStore, cancelToken, [&]() {
+      add(path, bbox, cancelToken, [&](Element &element) {
+        return elementStore->store(element, bbox, range, styleProvider);
+      });
     });
-
-    if (cancelToken.isCancelled())
-      elementStore->erase(bbox, range);
   }
 
+  /// Adds data from given file. Data outside of valid bounding box may be skipped by parser.
   utymap::BoundingBox add(const std::string &path,
+           const utymap::BoundingBox &bbox,
            const utymap::CancellationToken &cancelToken,
            const std::function<bool(Element &)> &functor) const {
     switch (getFormatTypeFromPath(path)) {
@@ -91,16 +305,28 @@ class GeoStore::GeoStoreImpl final {
       case FormatType::Xml: {
         OsmXmlParser<OsmDataVisitor> parser;
         std::ifstream xmlFile(path);
-        OsmDataVisitor visitor(stringTable_, functor, cancelToken);
+        OsmDataVisitor visitor(stringTable_, functor, cancelToken, createNodeLocationStore(path));
         parser.parse(xmlFile, visitor);
         return visitor.complete();
       }
 #ifdef PBF_SUPPORTED_ENABLED
       case FormatType::Pbf: {
-        OsmPbfParser<OsmDataVisitor> parser;
-        std::ifstream pbfFile(path, std::ios::in | std::ios::binary);
-        OsmDataVisitor visitor(stringTable_, functor, cancelToken);
-        parser.parse(pbfFile, visitor);
+        // NOTE relations are read in the first pass, so nodes and ways which are not
+        // relation members are added while the file is read in the second pass.
+        OsmDataVisitor visitor(stringTable_, functor, cancelToken, createNodeLocationStore(path), true);
+        {
+          OsmPbfParser<OsmRelationPass<OsmDataVisitor>> parser(stringTable_);
+          OsmRelationPass<OsmDataVisitor> pass(visitor);
+          std::ifstream pbfFile(path, std::ios::in | std::ios::binary);
+          parser.parse(pbfFile, pass, bbox);
+        }
+        if (cancelToken.isCancelled()) return utymap::BoundingBox();
+        {
+          OsmPbfParser<OsmElementPass<OsmDataVisitor>> parser(stringTable_);
+          OsmElementPass<OsmDataVisitor> pass(visitor);
+          std::ifstream pbfFile(path, std::ios::in | std::ios::binary);
+          parser.parse(pbfFile, pass, bbox);
+        }
         return visitor.complete();
       }
 #endif
@@ -121,21 +347,47 @@ class GeoStore::GeoStoreImpl final {
               const utymap::BoundingBox &bbox,
               const utymap::LodRange &range,
               ElementVisitor &visitor,
+              SearchPage &page,
               const utymap::CancellationToken &cancelToken) {
-    for (const auto &pair : storeMap_) {
-      pair.second->search(notTerms, andTerms, orTerms, bbox, range, visitor, cancelToken);
+    // NOTE position of the page depends on results of previous stores.
+    if (!page.isUnbounded()) {
+      std::uint32_t store = 0;
+      for (const auto &pair : storeMap_) {
+        if (page.isFull() || cancelToken.isCancelled()) break;
+        if (page.enterStore(store++))
+          pair.second->search(notTerms, andTerms, orTerms, bbox, range, visitor, page, cancelToken);
+      }
+      return;
     }
+
+    std::vector<ElementStore *> stores;
+    for (const auto &pair : storeMap_)
+      stores.push_back(pair.second.get());
+
+    // NOTE page of a store keeps elements of that store only, so elements which are
+    // found in many stores are filtered by the page of the whole search.
+    search(stores, [&](ElementStore &store, ElementVisitor &storeVisitor) {
+      SearchPage storePage;
+      store.search(notTerms, andTerms, orTerms, bbox, range, storeVisitor, storePage, cancelToken);
+    }, [&](const Element &element) {
+      return page.accept(element);
+    }, visitor);
   }
 
   void search(const QuadKey &quadKey,
               const StyleProvider &styleProvider,
               ElementVisitor &visitor,
               const CancellationToken &cancelToken) {
+    std::vector<ElementStore *> stores;
     for (const auto &pair : storeMap_) {
       // Search only if store has data
       if (pair.second->hasData(quadKey))
-        pair.second->search(quadKey, visitor, cancelToken);
+        stores.push_back(pair.second.get());
     }
+
+    search(stores, [&](ElementStore &store, ElementVisitor &storeVisitor) {
+      store.search(quadKey, storeVisitor, cancelToken);
+    }, nullptr, visitor);
   }
 
   bool hasData(const QuadKey &quadKey) {
@@ -147,8 +399,49 @@ class GeoStore::GeoStoreImpl final {
   }
 
  private:
+  /// Searches given stores, in parallel if there are more than one.
+  /// If filter is set, only elements accepted by it are visited when many stores are searched.
+  void search(const std::vector<ElementStore *> &stores,
+              const StoreFanOut::Search &search,
+              const StoreFanOut::Filter &filter,
+              ElementVisitor &visitor) {
+    if (stores.size() < 2) {
+      for (auto store : stores)
+        search(*store, visitor);
+      return;
+    }
+
+    std::call_once(workersFlag_, [&]() {
+      workers_ = utymap::utils::make_unique<WorkerPool>(
+        std::max<std::size_t>(std::thread::hardware_concurrency(), 2));
+    });
+    StoreFanOut(*workers_, stores, search, filter).run(visitor);
+  }
+
+  /// Imports data within single bulk load transaction which is rolled back
+  /// on cancellation or error, so previously stored data stays untouched.
+  static void bulkLoad(ElementStore &elementStore,
+                       const utymap::CancellationToken &cancelToken,
+                       const std::function<void()> &action) {
+    elementStore.begin();
+    try {
+      action();
+    } catch (...) {
+      elementStore.rollback();
+      throw;
+    }
+
+    if (cancelToken.isCancelled())
+      elementStore.rollback();
+    else
+      elementStore.commit();
+  }
+
   const StringTable &stringTable_;
   std::map<std::string, std::unique_ptr<ElementStore>> storeMap_;
+  /// Searches stores in parallel, created on first use.
+  std::unique_ptr<WorkerPool> workers_;
+  std::once_flag workersFlag_;
 
   static FormatType getFormatTypeFromPath(const std::string &path) {
     if (utymap::utils::endsWith(path, "pbf"))
@@ -218,8 +511,9 @@ void utymap::index::GeoStore::search(const std::string &notTerms,
                                      const utymap::BoundingBox &bbox,
                                      const utymap::LodRange &range,
                                      ElementVisitor &visitor,
+                                     SearchPage &page,
                                      const utymap::CancellationToken &cancelToken) {
-  pimpl_->search(notTerms, andTerms, orTerms, bbox, range, visitor, cancelToken);
+  pimpl_->search(notTerms, andTerms, orTerms, bbox, range, visitor, page, cancelToken);
 }
 
 bool utymap::index::GeoStore::hasData(const QuadKey &quadKey) const {
@@ -57,16 +57,21 @@ class GeoStore final {
            const utymap::mapcss::StyleProvider &styleProvider,
            const utymap::CancellationToken &cancelToken);
 
-  /// Searches for elements matches given query, bounding box and LOD range
+  /// Searches for elements matches given query, bounding box and LOD range.
+  /// Only elements of given page are visited, element found in many stores is visited once.
+  /// Paged search visits stores in key order. Unbounded page searches stores in parallel,
+  /// so elements are visited in any order, but always on calling thread.
   void search(const std::string &notTerms,
               const std::string &andTerms,
               const std::string &orTerms,
               const utymap::BoundingBox &bbox,
               const utymap::LodRange &range,
               utymap::entities::ElementVisitor &visitor,
+              utymap::index::SearchPage &page,
               const utymap::CancellationToken &cancelToken);
 
-  /// Searches for elements inside quadkey.
+  /// Searches for elements inside quadkey. Stores are searched in parallel,
+  /// so elements are visited in any order, but always on calling thread.
   void search(const QuadKey &quadKey,
               const utymap::mapcss::StyleProvider &styleProvider,
               utymap::entities::ElementVisitor &visitor,
@@ -6,6 +6,7 @@
 #include "index/ElementVisitorFilter.hpp"
 #include "index/InMemoryElementStore.hpp"
 #include "index/BitmapIndex.hpp"
+#include "utils/GeoUtils.hpp"
 
 using namespace utymap;
 using namespace utymap::index;
@@ -13,33 +14,225 @@ using namespace utymap::entities;
 using namespace utymap::mapcss;
 
 namespace {
-using Elements = std::vector<std::shared_ptr<Element>>;
-using ElementMap = std::map<QuadKey, Elements, QuadKey::Comparator>;
 using Bitmaps = std::map<QuadKey, BitmapIndex::Bitmap, QuadKey::Comparator>;
 
-class ElementMapVisitor : public ElementVisitor {
+/// Describes element stored in arena: its tags and data are ranges of arena buffers.
+struct ElementRecord {
+  std::uint64_t id;
+  ElementKind type;
+  std::uint32_t tagOffset;
+  std::uint32_t tagCount;
+  /// Range of coordinates for node, way and area or range of members for relation.
+  std::uint32_t dataOffset;
+  std::uint32_t dataCount;
+};
+
+/// Keeps all elements of quad key in flat buffers. Elements are appended
+/// in order, so element with given order and all next ones occupy tails of buffers.
+struct ElementArena {
+  /// Maps element order to its record, relation members are not listed.
+  std::vector<std::uint32_t> roots;
+  std::vector<ElementRecord> records;
+  std::vector<Tag> tags;
+  std::vector<GeoCoordinate> coordinates;
+  /// Records of relation members.
+  std::vector<std::uint32_t> members;
+
+  std::size_t size() const {
+    return roots.size();
+  }
+
+  /// Removes elements starting from given order.
+  void truncate(std::size_t count) {
+    if (count >= roots.size())
+      return;
+
+    auto index = roots[count];
+    tags.resize(records[index].tagOffset);
+    members.resize(getMemberOffset(index));
+    coordinates.resize(getCoordinateOffset(index));
+    records.resize(index);
+    roots.resize(count);
+  }
+
+ private:
+  /// Gets size of members buffer before given record was added.
+  std::size_t getMemberOffset(std::uint32_t index) const {
+    for (auto i = index; i < records.size(); ++i) {
+      if (records[i].type == ElementKind::Relation)
+        return records[i].dataOffset;
+    }
+    return members.size();
+  }
+
+  /// Gets size of coordinates buffer before given record was added.
+  std::size_t getCoordinateOffset(std::uint32_t index) const {
+    for (auto i = index; i < records.size(); ++i) {
+      if (records[i].type != ElementKind::Relation)
+        return records[i].dataOffset;
+    }
+    return coordinates.size();
+  }
+};
+
+using ElementMap = std::map<QuadKey, ElementArena, QuadKey::Comparator>;
+
+/// Appends elements to arena.
+class ElementArenaWriter final : public ElementVisitor {
  public:
-  ElementMapVisitor(Elements &elements) :
-      elements_(elements) {
+  explicit ElementArenaWriter(ElementArena &arena) :
+      arena_(arena), index_(0) {
+  }
+
+  /// Appends element as the next one in arena.
+  void add(const Element &element) {
+    arena_.roots.push_back(append(element));
   }
 
   void visitNode(const utymap::entities::Node &node) override {
-    elements_.push_back(std::make_shared<Node>(node));
+    arena_.coordinates.push_back(node.coordinate);
+    addRecord(node, ElementKind::Node, arena_.coordinates.size() - 1, 1);
   }
 
   void visitWay(const utymap::entities::Way &way) override {
-    elements_.push_back(std::make_shared<Way>(way));
+    addRecord(way, ElementKind::Way, arena_.coordinates.size(), way.coordinates.size());
+    arena_.coordinates.insert(arena_.coordinates.end(), way.coordinates.begin(), way.coordinates.end());
   }
 
   void visitArea(const utymap::entities::Area &area) override {
-    elements_.push_back(std::make_shared<Area>(area));
+    addRecord(area, ElementKind::Area, arena_.coordinates.size(), area.coordinates.size());
+    arena_.coordinates.insert(arena_.coordinates.end(), area.coordinates.begin(), area.coordinates.end());
   }
 
   void visitRelation(const utymap::entities::Relation &relation) override {
-    elements_.push_back(std::make_shared<Relation>(relation));
+    auto offset = arena_.members.size();
+    addRecord(relation, ElementKind::Relation, offset, relation.elements.size());
+    auto index = index_;
+    arena_.members.resize(offset + relation.elements.size());
+    for (std::size_t i = 0; i < relation.elements.size(); ++i) {
+      auto member = append(*relation.elements[i]);
+      arena_.members[offset + i] = member;
+    }
+    index_ = index;
   }
+
  private:
-  Elements &elements_;
+  /// Appends element with its members and returns index of its record.
+  std::uint32_t append(const Element &element) {
+    element.accept(*this);
+    return index_;
+  }
+
+  void addRecord(const Element &element, ElementKind type, std::size_t dataOffset, std::size_t dataCount) {
+    index_ = static_cast<std::uint32_t>(arena_.records.size());
+    arena_.records.push_back({ element.id, type,
+                               static_cast<std::uint32_t>(arena_.tags.size()),
+                               static_cast<std::uint32_t>(element.tags.size()),
+                               static_cast<std::uint32_t>(dataOffset),
+                               static_cast<std::uint32_t>(dataCount) });
+    arena_.tags.insert(arena_.tags.end(), element.tags.begin(), element.tags.end());
+  }
+
+  ElementArena &arena_;
+  /// Index of the last added record.
+  std::uint32_t index_;
+};
+
+/// Provides elements stored in arena to visitors. Elements without members are
+/// materialized into reused instances, so they are valid only during visit.
+class ElementArenaReader final {
+ public:
+  explicit ElementArenaReader(const ElementArena &arena) :
+      arena_(arena), node_(), way_(), area_() {
+  }
+
+  /// Gets standalone copy of element with given order.
+  std::shared_ptr<Element> get(std::uint32_t order) const {
+    return create(arena_.records.at(arena_.roots.at(order)));
+  }
+
+  /// Gets key of element with given order.
+  ElementKey getKey(std::uint32_t order) const {
+    const auto &record = arena_.records.at(arena_.roots.at(order));
+    return ElementKey{ record.id, record.type };
+  }
+
+  /// Visits element with given order.
+  void accept(std::uint32_t order, ElementVisitor &visitor) {
+    const auto &record = arena_.records.at(arena_.roots.at(order));
+    switch (record.type) {
+      case ElementKind::Node:
+        fill(record, node_);
+        node_.accept(visitor);
+        break;
+      case ElementKind::Way:
+        fill(record, way_);
+        way_.accept(visitor);
+        break;
+      case ElementKind::Area:
+        fill(record, area_);
+        area_.accept(visitor);
+        break;
+      case ElementKind::Relation:
+        create(record)->accept(visitor);
+        break;
+      case ElementKind::Unknown:
+        throw std::domain_error("Unknown element kind in memory store.");
+    }
+  }
+
+ private:
+  /// Creates standalone element from record.
+  std::shared_ptr<Element> create(const ElementRecord &record) const {
+    switch (record.type) {
+      case ElementKind::Node: {
+        auto node = std::make_shared<Node>();
+        fill(record, *node);
+        return node;
+      }
+      case ElementKind::Way: {
+        auto way = std::make_shared<Way>();
+        fill(record, *way);
+        return way;
+      }
+      case ElementKind::Area: {
+        auto area = std::make_shared<Area>();
+        fill(record, *area);
+        return area;
+      }
+      default: {
+        auto relation = std::make_shared<Relation>();
+        fillTags(record, *relation);
+        relation->elements.reserve(record.dataCount);
+        for (std::uint32_t i = 0; i < record.dataCount; ++i)
+          relation->elements.push_back(create(arena_.records[arena_.members[record.dataOffset + i]]));
+        return relation;
+      }
+    }
+  }
+
+  void fill(const ElementRecord &record, Node &node) const {
+    fillTags(record, node);
+    node.coordinate = arena_.coordinates[record.dataOffset];
+  }
+
+  template <typename T>
+  void fill(const ElementRecord &record, T &element) const {
+    fillTags(record, element);
+    auto begin = arena_.coordinates.begin() + record.dataOffset;
+    element.coordinates.assign(begin, begin + record.dataCount);
+  }
+
+  void fillTags(const ElementRecord &record, Element &element) const {
+    element.id = record.id;
+    auto begin = arena_.tags.begin() + record.tagOffset;
+    element.tags.assign(begin, begin + record.tagCount);
+  }
+
+  const ElementArena &arena_;
+  Node node_;
+  Way way_;
+  Area area_;
 };
 
 class InMemoryStringIndex : public BitmapIndex {
@@ -62,13 +255,23 @@ class InMemoryStringIndex : public BitmapIndex {
     if (elements==elementsMap_.end())
       throw std::domain_error("Cannot find element in memory while searching text!");
 
-    elements->second.at(order)->accept(visitor);
+    ElementArenaReader(elements->second).accept(order, visitor);
   }
 
   Bitmap &getBitmap(const utymap::QuadKey &quadKey) override {
     return bitmaps_[quadKey];
   }
 
+  void getElementKeys(const utymap::QuadKey &quadKey, const Ids &orders, std::vector<ElementKey> &keys) override {
+    auto elements = elementsMap_.find(quadKey);
+    if (elements == elementsMap_.end()) return;
+
+    ElementArenaReader reader(elements->second);
+    keys.reserve(orders.size());
+    for (auto order : orders)
+      keys.push_back(reader.getKey(order));
+  }
+
   bool hasData(const utymap::QuadKey &quadKey) const override {
     return elementsMap_.find(quadKey) != elementsMap_.end();
   }
@@ -84,15 +287,52 @@ class InMemoryElementStore::InMemoryElementStoreImpl {
   explicit InMemoryElementStoreImpl(const StringTable &stringTable) :
       stringTable_(stringTable),
       elementsMap_(),
-      stringIndex_(stringTable, elementsMap_) {}
+      stringIndex_(stringTable, elementsMap_),
+      transactionCounts_(),
+      isInTransaction_(false) {}
+
+  void begin() {
+    if (isInTransaction_)
+      throw std::domain_error("Bulk load transaction is already started.");
+    isInTransaction_ = true;
+  }
+
+  void commit() {
+    transactionCounts_.clear();
+    isInTransaction_ = false;
+  }
+
+  void rollback() {
+    for (const auto &pair : transactionCounts_) {
+      const auto &quadKey = pair.first;
+      if (pair.second == 0) {
+        erase(quadKey);
+        continue;
+      }
+
+      auto &arena = elementsMap_[quadKey];
+      arena.truncate(pair.second);
+
+      // NOTE bitmap cannot be truncated, so rebuild it from remaining elements.
+      stringIndex_.erase(quadKey);
+      ElementArenaReader reader(arena);
+      for (std::size_t i = 0; i < arena.size(); ++i)
+        stringIndex_.add(*reader.get(static_cast<std::uint32_t>(i)), quadKey, static_cast<std::uint32_t>(i));
+    }
+    commit();
+  }
 
   void search(const BitmapIndex::Query &query,
               ElementVisitor &visitor,
+              SearchPage &page,
               const utymap::CancellationToken &cancelToken) {
-    ElementVisitorFilter filter(visitor, [&](const Element &element) {
+    ElementVisitorFilter pageFilter(visitor, [&](const Element &element) {
+      return page.accept(element);
+    });
+    ElementVisitorFilter filter(pageFilter, [&](const Element &element) {
       return ElementGeometryVisitor::intersects(element, query.boundingBox);
     });
-    stringIndex_.search(query, filter);
+    stringIndex_.search(query, filter, page);
   }
 
   void search(const utymap::QuadKey &quadKey,
@@ -103,9 +343,10 @@ class InMemoryElementStore::InMemoryElementStoreImpl {
     if (it == end())
       return;
 
-    for (const auto &element : it->second) {
+    ElementArenaReader reader(it->second);
+    for (std::size_t i = 0; i < it->second.size(); ++i) {
       if (cancelToken.isCancelled()) break;
-      element->accept(visitor);
+      reader.accept(static_cast<std::uint32_t>(i), visitor);
     }
   }
 
@@ -114,11 +355,12 @@ class InMemoryElementStore::InMemoryElementStoreImpl {
   }
 
   void store(const utymap::entities::Element &element, const QuadKey &quadKey) {
-    auto &elements = elementsMap_[quadKey];
+    auto &arena = elementsMap_[quadKey];
+    if (isInTransaction_)
+      transactionCounts_.emplace(quadKey, arena.size());
 
-    stringIndex_.add(element, quadKey, static_cast<std::uint32_t>(elements.size()));
-    ElementMapVisitor visitor(elements);
-    element.accept(visitor);
+    stringIndex_.add(element, quadKey, static_cast<std::uint32_t>(arena.size()));
+    ElementArenaWriter(arena).add(element);
   }
 
   void erase(const utymap::QuadKey &quadKey) {
@@ -127,7 +369,11 @@ class InMemoryElementStore::InMemoryElementStoreImpl {
   }
 
   void erase(const utymap::BoundingBox &bbox, const utymap::LodRange &range) {
-    throw std::domain_error("Deletion by bounding box and lod range is not implemented.");
+    for (int lod = range.start; lod <= range.end; ++lod) {
+      utymap::utils::GeoUtils::visitTileRange(bbox, lod, [&](const QuadKey &quadKey, const BoundingBox &) {
+        erase(quadKey);
+      });
+    }
   }
 
  private:
@@ -142,6 +388,9 @@ class InMemoryElementStore::InMemoryElementStoreImpl {
   const StringTable &stringTable_;
   ElementMap elementsMap_;
   InMemoryStringIndex stringIndex_;
+  /// Element counts of quad keys modified within transaction.
+  std::map<QuadKey, std::size_t, QuadKey::Comparator> transactionCounts_;
+  bool isInTransaction_;
 };
 
 InMemoryElementStore::InMemoryElementStore(const StringTable &stringTable) :
@@ -155,6 +404,18 @@ void InMemoryElementStore::save(const Element &element, const QuadKey &quadKey)
   pimpl_->store(element, quadKey);
 }
 
+void InMemoryElementStore::begin() {
+  pimpl_->begin();
+}
+
+void InMemoryElementStore::commit() {
+  pimpl_->commit();
+}
+
+void InMemoryElementStore::rollback() {
+  pimpl_->rollback();
+}
+
 bool InMemoryElementStore::hasData(const utymap::QuadKey &quadKey) const {
   return pimpl_->hasData(quadKey);
 }
@@ -165,9 +426,10 @@ void InMemoryElementStore::search(const std::string &notTerms,
                                   const utymap::BoundingBox &bbox,
                                   const utymap::LodRange &range,
                                   ElementVisitor &visitor,
+                                  SearchPage &page,
                                   const utymap::CancellationToken &cancelToken) {
   BitmapIndex::Query query = { notTerms, andTerms, orTerms, bbox, range };
-  pimpl_->search(query, visitor, cancelToken);
+  pimpl_->search(query, visitor, page, cancelToken);
 }
 
 void InMemoryElementStore::search(const utymap::QuadKey &quadKey,
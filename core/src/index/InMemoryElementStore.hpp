@@ -11,24 +11,34 @@ namespace utymap {
 namespace index {
 
 /// Provides API to store elements in memory.
+/// Elements of each quad key are kept in flat buffers instead of separate objects.
 class InMemoryElementStore final : public ElementStore {
  public:
   explicit InMemoryElementStore(const utymap::index::StringTable &stringTable);
 
   virtual ~InMemoryElementStore();
 
+  using ElementStore::search;
+
   void search(const std::string &notTerms,
               const std::string &andTerms,
               const std::string &orTerms,
               const utymap::BoundingBox &bbox,
               const utymap::LodRange &range,
               utymap::entities::ElementVisitor &visitor,
+              utymap::index::SearchPage &page,
               const utymap::CancellationToken &cancelToken) override;
 
   void search(const utymap::QuadKey &quadKey,
               utymap::entities::ElementVisitor &visitor,
               const utymap::CancellationToken &cancelToken) override;
 
+  void begin() override;
+
+  void commit() override;
+
+  void rollback() override;
+
   void save(const utymap::entities::Element &element,
             const utymap::QuadKey &quadKey) override;
 
@@ -4,12 +4,35 @@
 #include "index/ElementGeometryVisitor.hpp"
 #include "index/ElementVisitorFilter.hpp"
 #include "index/PersistentElementStore.hpp"
+#include "utils/CoreUtils.hpp"
 #include "utils/LruCache.hpp"
 
+#include <boost/interprocess/detail/os_file_functions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#ifdef PBF_SUPPORTED_ENABLED
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
 #include <cstdio>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
 #include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
 
 using namespace utymap;
 using namespace utymap::index;
@@ -18,232 +41,2035 @@ using namespace utymap::mapcss;
 using namespace utymap::utils;
 
 namespace {
-const std::string IndexFileExtension = ".idf";
-const std::string DataFileExtension = ".dat";
-const std::string bitmapFileExtension = ".bmp";
+/// Defines amount of levels packed into single container file: all tiles of
+/// the same level of detail which have common parent on (lod - PackDepth)
+/// level are stored together. So, tiles of lower levels share one file per LOD.
+const int PackDepth = 8;
+const std::string ContainerFilePrefix = "tiles";
+const std::string ContainerFileExtension = ".pack";
+const std::string CompactionFileExtension = ".tmp";
+/// Keeps generation of container data file: compaction writes data into file of the next
+/// generation, so file of the current one is never replaced while it is mapped.
+const std::string GenerationFileExtension = ".gen";
+/// Lists names of container files created for level of detail.
+const std::string ContainerListFile = "tiles.lst";
+/// Keeps elements shared by tiles of level of detail.
+const std::string SharedFile = "shared.dat";
+/// Keeps version of data layout in data directory.
+const std::string FormatFile = "format.ver";
+/// Version of data layout: tiles are packed into containers.
+const int FormatVersion = 2;
+/// Extension of index files of the first layout which kept files per tile.
+const std::string LegacyIndexExtension = ".idf";
+/// Keeps tile presence filter in data directory, so it is not rebuilt on start.
+const std::string FilterFile = "tiles.flt";
+/// Marks the beginning of filter file.
+const std::uint32_t FilterMarker = 0x544C4946;
+
+/// Elements of this size or bigger are moved to shared file when they are stored again.
+const std::size_t SharedElementMinSize = 1024;
+/// Marks reference to shared element in element data instead of element itself.
+const unsigned char SharedElementMarker = 0xFF;
+/// Amount of decoded shared elements kept in memory per level of detail.
+const std::size_t SharedCacheSize = 64;
+
+/// Amount of values in element bounds: min latitude, min longitude, max latitude and max longitude.
+const std::size_t BoundsSize = 4;
+/// Marks the end of bitmap record which has element bounds after bitmap data.
+const std::uint32_t BoundsMarker = 0x53444E42;
+/// Size of bitmap record trailer: amount of element bounds and marker.
+const std::size_t BoundsTrailerSize = 2 * sizeof(std::uint32_t);
+
+/// Amount of bits in tile presence filter, should be power of two.
+const std::uint64_t FilterBits = 1 << 23;
+/// Amount of bits checked in presence filter per tile.
+const int FilterProbes = 4;
+
+/// Containers smaller than this size are not compacted in background.
+const std::uint64_t MinCompactionSize = 64 * 1024;
+/// Container is compacted when dead records take more than this part of it.
+const double MaxDeadRatio = 0.5;
+/// Container is compacted when its tiles consist of more records in average.
+const std::size_t MaxChunksPerTile = 8;
+
+/// Size of index entry: element id and its offset in data of elements record.
+const std::size_t IndexEntrySize = sizeof(std::uint64_t) + sizeof(std::uint32_t);
+
+/// Size of uncompressed block of element data in compressed elements record.
+const std::uint32_t BlockSize = 64 * 1024;
+/// Amount of bits used for element offset inside block in compressed index entry.
+const int BlockOffsetBits = 16;
+/// Size of block table entry: offset of compressed block, its size and size of decompressed data.
+const std::size_t BlockEntrySize = 3 * sizeof(std::uint32_t);
+/// Amount of decompressed blocks cached by tile snapshot.
+const std::size_t BlockCacheSize = 4;
+
+/// Size of record header: type, tile x, tile y and payload size.
+const std::size_t RecordHeaderSize = sizeof(std::uint8_t) + 2 * sizeof(std::int32_t) + sizeof(std::uint32_t);
+
+/// Defines types of records stored in container file.
+enum class RecordType : std::uint8_t {
+  /// Element count, index entries and element data.
+  Elements = 1,
+  /// Search bitmap of tile, the latest one is used.
+  Bitmap = 2,
+  /// Marks all previous records of tile as deleted.
+  Erase = 3,
+  /// Element count, index entries with block and offset inside it,
+  /// block table and element data blocks compressed independently.
+  CompressedElements = 4,
+  /// Elements record of transaction which is not committed yet, ignored on load.
+  PendingElements = 5,
+  /// Compressed elements record of transaction which is not committed yet, ignored on load.
+  PendingCompressedElements = 6
+};
+
+#ifdef PBF_SUPPORTED_ENABLED
+// NOTE zlib is available together with pbf support.
+bool isCompressionSupported() {
+  return true;
+}
+
+std::string compressBlock(const char *data, std::size_t size) {
+  auto compressedSize = compressBound(static_cast<uLong>(size));
+  std::string compressed(compressedSize, '\0');
+  if (compress(reinterpret_cast<Bytef *>(&compressed[0]), &compressedSize,
+               reinterpret_cast<const Bytef *>(data), static_cast<uLong>(size)) != Z_OK)
+    throw std::domain_error("Cannot compress element data.");
+  compressed.resize(compressedSize);
+  return compressed;
+}
+
+std::string decompressBlock(const char *data, std::size_t size, std::size_t rawSize) {
+  std::string block(rawSize, '\0');
+  uLongf blockSize = static_cast<uLongf>(rawSize);
+  if (uncompress(reinterpret_cast<Bytef *>(&block[0]), &blockSize,
+                 reinterpret_cast<const Bytef *>(data), static_cast<uLong>(size)) != Z_OK || blockSize != rawSize)
+    throw std::domain_error("Cannot decompress element data.");
+  return block;
+}
+#else
+bool isCompressionSupported() {
+  return false;
+}
+
+std::string compressBlock(const char *, std::size_t) {
+  throw std::domain_error("Compression is not supported.");
+}
+
+std::string decompressBlock(const char *, std::size_t, std::size_t) {
+  throw std::domain_error("Compression is not supported.");
+}
+#endif
+
+/// Replaces target file with source one.
+void replaceFile(const std::string &source, const std::string &target) {
+  // NOTE rename does not replace existing file on some platforms.
+  if (std::rename(source.c_str(), target.c_str()) != 0 &&
+      (std::remove(target.c_str()) != 0 || std::rename(source.c_str(), target.c_str()) != 0)) {
+    std::remove(source.c_str());
+    throw std::domain_error("Cannot replace " + target);
+  }
+}
+
+template<typename T>
+void appendValue(std::string &buffer, const T &value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/// Provides read only access to file content mapped into memory.
+class MappedFile final {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    unmap();
+    if (!removePath_.empty() && std::remove(removePath_.c_str()))
+      std::cerr << "Cannot remove " << removePath_ << std::endl;
+  }
+
+  /// Maps content of given file. Missing or empty file results in empty view.
+  void map(const std::string &path) {
+    using namespace boost::interprocess;
+    unmap();
+    std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.good() || file.tellg() <= 0)
+      return;
+
+    file_mapping mapping(path.c_str(), read_only);
+    region_ = mapped_region(mapping, read_only);
+  }
+
+  /// Releases mapped view.
+  void unmap() {
+    region_ = boost::interprocess::mapped_region();
+  }
+
+  const char *data() const {
+    return static_cast<const char *>(region_.get_address());
+  }
+
+  std::size_t size() const {
+    return region_.get_size();
+  }
+
+  /// Removes given file when mapping is released.
+  void removeOnRelease(const std::string &path) {
+    removePath_ = path;
+  }
+
+ private:
+  boost::interprocess::mapped_region region_;
+  std::string removePath_;
+};
+
+/// Specifies elements record written by transaction which is not committed yet.
+struct PendingChunk {
+  QuadKey quadKey;
+  std::uint64_t offset;
+  std::uint32_t size;
+  std::uint32_t count;
+};
+
+/// Specifies location of elements record payload in container file.
+struct Chunk {
+  std::uint64_t offset;
+  std::uint32_t size;
+  /// Order of the first element in tile.
+  std::uint32_t firstOrder;
+  std::uint32_t count;
+  bool isCompressed;
+};
+
+/// Provides access to blocks of compressed elements record.
+class CompressedChunk final {
+ public:
+  CompressedChunk(const char *payload, const Chunk &chunk) :
+      blockCount_(0), table_(nullptr), blocks_(nullptr), end_(payload + chunk.size) {
+    auto tableOffset = sizeof(std::uint32_t) + chunk.count * IndexEntrySize;
+    if (tableOffset + sizeof(blockCount_) > chunk.size)
+      throw std::domain_error("Cannot find element blocks.");
+
+    std::memcpy(&blockCount_, payload + tableOffset, sizeof(blockCount_));
+    table_ = payload + tableOffset + sizeof(blockCount_);
+    if (blockCount_ * BlockEntrySize > static_cast<std::size_t>(end_ - table_))
+      throw std::domain_error("Cannot find element blocks.");
+    blocks_ = table_ + blockCount_ * BlockEntrySize;
+  }
+
+  std::uint32_t getBlockCount() const {
+    return blockCount_;
+  }
+
+  /// Decompresses block with given number.
+  std::string decompress(std::uint32_t block) const {
+    if (block >= blockCount_)
+      throw std::domain_error("Cannot find element block.");
+
+    std::uint32_t offset, size, rawSize;
+    const char *entry = table_ + block * BlockEntrySize;
+    std::memcpy(&offset, entry, sizeof(offset));
+    std::memcpy(&size, entry + sizeof(offset), sizeof(size));
+    std::memcpy(&rawSize, entry + sizeof(offset) + sizeof(size), sizeof(rawSize));
+    if (static_cast<std::size_t>(offset) + size > static_cast<std::size_t>(end_ - blocks_))
+      throw std::domain_error("Cannot find element block.");
+
+    return decompressBlock(blocks_ + offset, size, rawSize);
+  }
+
+ private:
+  std::uint32_t blockCount_;
+  const char *table_;
+  const char *blocks_;
+  const char *end_;
+};
+
+/// Immutable snapshot of tile data which stays valid when container is modified.
+struct TileView {
+  using BlockKey = std::pair<std::uint64_t, std::uint32_t>;
+
+  std::shared_ptr<const MappedFile> file;
+  std::vector<Chunk> chunks;
+  std::uint32_t count;
 
-struct BitmapData {
-  const std::string path;
-  BitmapIndex::Bitmap data;
+  TileView() : file(), chunks(), count(0), blocks_(BlockCacheSize), lock_() {}
 
-  BitmapData(const std::string &bitmapPath) :
-    path(bitmapPath) {}
+  /// Gets decompressed block of given chunk. Recently used blocks are cached,
+  /// so elements of the same block are decompressed only once.
+  std::shared_ptr<std::string> getBlock(const Chunk &chunk, std::uint32_t block) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    BlockKey key(chunk.offset, block);
+    if (!blocks_.exists(key)) {
+      CompressedChunk compressed(file->data() + chunk.offset, chunk);
+      blocks_.put(key, compressed.decompress(block));
+    }
+    return blocks_.get(key);
+  }
 
-  BitmapData(BitmapData &&other) :
-    path(std::move(other.path)),
-    data(std::move(other.data)) {}
+ private:
+  mutable utymap::utils::LruCache<BlockKey, std::string> blocks_;
+  mutable std::mutex lock_;
 };
 
-/// Stores file handlers related to data of specific quad key.
-struct QuadKeyData {
-  std::unique_ptr<std::fstream> dataFile;
-  std::unique_ptr<std::fstream> indexFile;
+/// Creates payload of elements record. Index entries should contain
+/// element offsets relative to the beginning of data. If compression is
+/// requested, data is split into blocks which are compressed independently
+/// and each index entry points to block and offset inside it.
+std::string createPayload(bool isCompressed,
+                          std::uint32_t count,
+                          const std::vector<char> &index,
+                          const std::string &data) {
+  std::string payload;
+  appendValue(payload, count);
+  if (!isCompressed) {
+    payload.reserve(sizeof(count) + index.size() + data.size());
+    payload.append(index.data(), index.size());
+    payload.append(data);
+    return payload;
+  }
+
+  std::string blockTable;
+  std::string blocks;
+  std::uint32_t blockCount = 0;
+  std::uint32_t blockStart = 0;
+  auto closeBlock = [&](std::uint32_t blockEnd) {
+    if (++blockCount > (1u << (32 - BlockOffsetBits)))
+      throw std::domain_error("Too many element blocks.");
+    auto compressed = compressBlock(data.data() + blockStart, blockEnd - blockStart);
+    appendValue(blockTable, static_cast<std::uint32_t>(blocks.size()));
+    appendValue(blockTable, static_cast<std::uint32_t>(compressed.size()));
+    appendValue(blockTable, blockEnd - blockStart);
+    blocks.append(compressed);
+    blockStart = blockEnd;
+  };
+
+  for (std::uint32_t i = 0; i < count; ++i) {
+    std::uint32_t begin, end = static_cast<std::uint32_t>(data.size());
+    std::memcpy(&begin, index.data() + i * IndexEntrySize + sizeof(std::uint64_t), sizeof(begin));
+    if (i + 1 < count)
+      std::memcpy(&end, index.data() + (i + 1) * IndexEntrySize + sizeof(std::uint64_t), sizeof(end));
+
+    // NOTE element bigger than block takes the whole block.
+    if (begin > blockStart && end - blockStart >= BlockSize)
+      closeBlock(begin);
 
-  QuadKeyData(const std::string &dataPath,
-              const std::string &indexPath,
-              const std::string &bitmapPath) :
-      dataFile(utymap::utils::make_unique<std::fstream>()),
-      indexFile(utymap::utils::make_unique<std::fstream>()),
-      dataPath_(dataPath),
-      indexPath_(indexPath),
-      bitmapPath_(bitmapPath),
-      bitmapData_(utymap::utils::make_unique<BitmapData>(bitmapPath)) {
-    using std::ios;
-    dataFile->open(dataPath, ios::in | ios::out | ios::binary | ios::app | ios::ate);
-    indexFile->open(indexPath, ios::in | ios::out | ios::binary | ios::app | ios::ate);
+    payload.append(index.data() + i * IndexEntrySize, sizeof(std::uint64_t));
+    appendValue(payload, (blockCount << BlockOffsetBits) | (begin - blockStart));
   }
+  if (count > 0)
+    closeBlock(static_cast<std::uint32_t>(data.size()));
+
+  appendValue(payload, blockCount);
+  payload.append(blockTable);
+  payload.append(blocks);
+  return payload;
+}
+
+/// Appends index entries and decompressed element data of chunk to given buffers.
+void appendChunk(const MappedFile &file, const Chunk &chunk, std::vector<char> &index, std::string &data) {
+  const char *payload = file.data() + chunk.offset;
+  const char *entries = payload + sizeof(std::uint32_t);
+  auto indexSize = chunk.count * IndexEntrySize;
+  auto base = static_cast<std::uint32_t>(data.size());
 
-  BitmapData& getBitmap() const {
-    if (bitmapData_->data.empty()) {
-      // TODO not thread safe!
-      std::fstream bitmapFile;
-      bitmapFile.open(bitmapData_->path, std::ios::in | std::ios::binary);
-      BitmapStream::read(bitmapFile, bitmapData_->data);
+  std::vector<std::uint32_t> blockStarts;
+  if (chunk.isCompressed) {
+    CompressedChunk compressed(payload, chunk);
+    for (std::uint32_t block = 0; block < compressed.getBlockCount(); ++block) {
+      blockStarts.push_back(static_cast<std::uint32_t>(data.size()) - base);
+      data.append(compressed.decompress(block));
     }
-    return *bitmapData_;
+  } else {
+    data.append(entries + indexSize, chunk.size - sizeof(std::uint32_t) - indexSize);
   }
 
-  QuadKeyData(const QuadKeyData &) = delete;
-  QuadKeyData &operator=(const QuadKeyData &) = delete;
+  for (std::uint32_t i = 0; i < chunk.count; ++i) {
+    std::uint32_t offset;
+    const char *entry = entries + i * IndexEntrySize;
+    std::memcpy(&offset, entry + sizeof(std::uint64_t), sizeof(offset));
+    if (chunk.isCompressed)
+      offset = blockStarts.at(offset >> BlockOffsetBits) + (offset & ((1u << BlockOffsetBits) - 1));
+    offset += base;
+    index.insert(index.end(), entry, entry + sizeof(std::uint64_t));
+    index.insert(index.end(), reinterpret_cast<const char *>(&offset),
+                 reinterpret_cast<const char *>(&offset) + sizeof(offset));
+  }
+}
 
-  QuadKeyData(QuadKeyData &&other) :
-      dataFile(std::move(other.dataFile)),
-      indexFile(std::move(other.indexFile)),
-      dataPath_(std::move(other.dataPath_)),
-      indexPath_(std::move(other.indexPath_)),
-      bitmapPath_(std::move(other.bitmapPath_)),
-      bitmapData_(std::move(other.bitmapData_)) {}
+/// Represents directory entry of tile.
+struct Tile {
+  std::vector<Chunk> chunks;
+  std::uint32_t count = 0;
+  std::uint64_t bitmapOffset = 0;
+  std::uint32_t bitmapSize = 0;
+  /// Cached snapshot, it is reset when tile is modified.
+  std::shared_ptr<const TileView> view;
+};
 
-  ~QuadKeyData() {
-    closeAll();
+/// Bloom filter of tiles which have data keyed by morton code of quad key.
+/// Filter gives no false negatives, so only positive answers should be checked
+/// against container. Erased tiles cannot be removed and stay positive.
+class TileFilter final {
+ public:
+  TileFilter() : bits_(new std::atomic<std::uint64_t>[FilterBits / 64]) {
+    for (std::size_t i = 0; i < FilterBits / 64; ++i)
+      bits_[i].store(0, std::memory_order_relaxed);
   }
 
-  void erase() {
-    closeAll();
-    if (std::remove(dataPath_.c_str())) logEraseError(dataPath_);
-    if (std::remove(indexPath_.c_str())) logEraseError(indexPath_);
-    if (std::remove(bitmapPath_.c_str())) logEraseError(bitmapPath_);
+  void add(const QuadKey &quadKey) {
+    auto hash = getHash(quadKey);
+    for (int i = 0; i < FilterProbes; ++i) {
+      auto bit = getBit(hash, i);
+      bits_[bit >> 6].fetch_or(std::uint64_t(1) << (bit & 63), std::memory_order_relaxed);
+    }
   }
 
-private:
-  void closeAll() const {
-    if (dataFile != nullptr && dataFile->good()) dataFile->close();
-    if (indexFile != nullptr && indexFile->good()) indexFile->close();
+  /// Returns false if tile definitely has no data.
+  bool mayContain(const QuadKey &quadKey) const {
+    auto hash = getHash(quadKey);
+    for (int i = 0; i < FilterProbes; ++i) {
+      auto bit = getBit(hash, i);
+      if ((bits_[bit >> 6].load(std::memory_order_relaxed) & (std::uint64_t(1) << (bit & 63))) == 0)
+        return false;
+    }
+    return true;
   }
 
-  static void logEraseError(const std::string &path) {
-    std::cerr << "Cannot erase " << path << std::endl;
+  /// Adds tiles of filter written to given stream. Returns false if stream
+  /// does not contain filter with the same parameters.
+  bool read(std::istream &in) {
+    std::uint32_t marker = 0, probes = 0;
+    std::uint64_t bits = 0;
+    in.read(reinterpret_cast<char *>(&marker), sizeof(marker));
+    in.read(reinterpret_cast<char *>(&bits), sizeof(bits));
+    in.read(reinterpret_cast<char *>(&probes), sizeof(probes));
+    if (!in.good() || marker != FilterMarker || bits != FilterBits || probes != FilterProbes)
+      return false;
+
+    std::vector<std::uint64_t> words(FilterBits / 64);
+    in.read(reinterpret_cast<char *>(words.data()), words.size() * sizeof(std::uint64_t));
+    if (in.gcount() != static_cast<std::streamsize>(words.size() * sizeof(std::uint64_t)))
+      return false;
+
+    for (std::size_t i = 0; i < words.size(); ++i)
+      bits_[i].fetch_or(words[i], std::memory_order_relaxed);
+    return true;
   }
 
-  const std::string dataPath_;
-  const std::string indexPath_;
-  const std::string bitmapPath_;
-  std::unique_ptr<BitmapData> bitmapData_;
+  void write(std::ostream &out) const {
+    std::uint64_t bits = FilterBits;
+    std::uint32_t probes = FilterProbes;
+    out.write(reinterpret_cast<const char *>(&FilterMarker), sizeof(FilterMarker));
+    out.write(reinterpret_cast<const char *>(&bits), sizeof(bits));
+    out.write(reinterpret_cast<const char *>(&probes), sizeof(probes));
+    for (std::size_t i = 0; i < FilterBits / 64; ++i) {
+      auto word = bits_[i].load(std::memory_order_relaxed);
+      out.write(reinterpret_cast<const char *>(&word), sizeof(word));
+    }
+  }
+
+ private:
+  /// Gets bit index of given probe using double hashing.
+  static std::uint64_t getBit(std::uint64_t hash, int probe) {
+    auto h1 = hash & 0xFFFFFFFF;
+    auto h2 = (hash >> 32) | 1;
+    return (h1 + probe * h2) & (FilterBits - 1);
+  }
+
+  /// Mixes morton code of tile with its level of detail.
+  static std::uint64_t getHash(const QuadKey &quadKey) {
+    std::uint64_t key = (spread(static_cast<std::uint32_t>(quadKey.tileY)) << 1) |
+        spread(static_cast<std::uint32_t>(quadKey.tileX));
+    key ^= static_cast<std::uint64_t>(quadKey.levelOfDetail) << 58;
+
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return key ^ (key >> 31);
+  }
+
+  /// Spreads lower 29 bits of value to even bits.
+  static std::uint64_t spread(std::uint32_t value) {
+    std::uint64_t x = value & 0x1FFFFFFF;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | (x << 2)) & 0x3333333333333333ULL;
+    x = (x | (x << 1)) & 0x5555555555555555ULL;
+    return x;
+  }
+
+  std::unique_ptr<std::atomic<std::uint64_t>[]> bits_;
+};
+
+/// Keeps bitmap of tile in memory. Modified bitmap is appended to
+/// container only once when container is flushed or released.
+/// Bitmap data is shared with snapshots taken by searches, so it is
+/// copied before modification while any snapshot is still alive.
+struct TileBitmap {
+  std::shared_ptr<BitmapIndex::Bitmap> data = std::make_shared<BitmapIndex::Bitmap>();
+  /// Element bounding boxes by store order, they are written after bitmap
+  /// data in the same record followed by trailer. Elements without bounds are not filtered.
+  std::vector<float> bounds;
+  bool isDirty = false;
 };
+
+/// Converts value to float which is not greater than given one.
+float roundDown(double value) {
+  auto result = static_cast<float>(value);
+  return result > value ? std::nextafter(result, -std::numeric_limits<float>::infinity()) : result;
+}
+
+/// Converts value to float which is not less than given one.
+float roundUp(double value) {
+  auto result = static_cast<float>(value);
+  return result < value ? std::nextafter(result, std::numeric_limits<float>::infinity()) : result;
+}
+
+/// Appends bounds of element with given order. Missing bounds of previous elements
+/// are filled with the whole world.
+void appendBounds(std::vector<float> &bounds, std::uint32_t order, const BoundingBox &bbox) {
+  const float max = std::numeric_limits<float>::max();
+  while (bounds.size() < order * BoundsSize) {
+    bounds.insert(bounds.end(), { -max, -max, max, max });
+  }
+  bounds.resize(order * BoundsSize);
+  bounds.insert(bounds.end(), { roundDown(bbox.minPoint.latitude), roundDown(bbox.minPoint.longitude),
+                                roundUp(bbox.maxPoint.latitude), roundUp(bbox.maxPoint.longitude) });
+}
+
+/// Checks whether element with given order may intersect bounding box.
+bool intersects(const std::vector<float> &bounds, std::uint32_t order, const BoundingBox &bbox) {
+  if ((order + 1) * BoundsSize > bounds.size())
+    return true;
+
+  const float *b = bounds.data() + order * BoundsSize;
+  return b[0] <= bbox.maxPoint.latitude && b[1] <= bbox.maxPoint.longitude &&
+         b[2] >= bbox.minPoint.latitude && b[3] >= bbox.minPoint.longitude;
 }
 
-using Cache = utymap::utils::LruCache<QuadKey, QuadKeyData, QuadKey::Comparator>;
+/// Packs data of multiple tiles of the same level of detail into single
+/// append only file and keeps in-memory directory of tile records.
+/// Readers work with immutable memory views, so they do not share any stream
+/// position; all modifications are serialized by container lock.
+/// Data is kept in file of the current generation: the first one uses container
+/// path, compaction switches container to file of the next one.
+class Container final {
+ public:
+  /// Defines bitmap update action which receives order of the first appended element.
+  using BitmapAction = std::function<void(std::uint32_t, BitmapIndex::Bitmap &)>;
+
+  Container(const std::string &path, int levelOfDetail, bool isCompressed) :
+      path_(path), generation_(readGeneration(path)), dataPath_(getDataPath(path, generation_)),
+      levelOfDetail_(levelOfDetail), isCompressed_(isCompressed), size_(0), deadSize_(0), chunkCount_(0), version_(0),
+      file_(), tiles_(), bitmaps_(), pending_(), stream_(), lock_() {
+    // NOTE file of previous generation is left when it was still mapped on replacement.
+    if (generation_ > 0)
+      std::remove(getDataPath(path_, generation_ - 1).c_str());
+
+    auto file = std::make_shared<MappedFile>();
+    file->map(dataPath_);
+    scan(*file);
+    file_ = file;
+  }
+
+  /// Checks whether container with given path has data file.
+  static bool exists(const std::string &path) {
+    return std::ifstream(getDataPath(path, readGeneration(path))).good();
+  }
+
+  Container(const Container &) = delete;
+  Container &operator=(const Container &) = delete;
+
+  ~Container() {
+    flush();
+  }
+
+  /// Checks whether tile has data in container.
+  bool hasTile(const QuadKey &quadKey) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return tiles_.find(quadKey) != tiles_.end();
+  }
+
+  /// Checks whether container has no tiles.
+  bool isEmpty() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return tiles_.empty();
+  }
+
+  /// Returns all tiles which have data in container.
+  std::vector<QuadKey> getTiles() {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::vector<QuadKey> tiles;
+    tiles.reserve(tiles_.size());
+    for (const auto &pair : tiles_)
+      tiles.push_back(pair.first);
+    return tiles;
+  }
+
+  /// Returns amount of elements stored for tile.
+  std::uint32_t getCount(const QuadKey &quadKey) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto tile = tiles_.find(quadKey);
+    return tile == tiles_.end() ? 0 : tile->second.count;
+  }
+
+  /// Gets snapshot of tile data.
+  std::shared_ptr<const TileView> getView(const QuadKey &quadKey) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto tilePair = tiles_.find(quadKey);
+    if (tilePair == tiles_.end() || tilePair->second.chunks.empty())
+      return std::make_shared<TileView>();
+
+    auto &tile = tilePair->second;
+    if (tile.view != nullptr)
+      return tile.view;
+
+    // NOTE existing mapping is still valid for data written before it was created.
+    const auto &last = tile.chunks.back();
+    ensureMapped(last.offset + last.size);
+
+    auto view = std::make_shared<TileView>();
+    view->file = file_;
+    view->chunks = tile.chunks;
+    view->count = tile.count;
+    tile.view = view;
+    return view;
+  }
+
+  /// Gets snapshot of tile bitmap loading it if necessary.
+  std::shared_ptr<const BitmapIndex::Bitmap> getBitmap(const QuadKey &quadKey) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return loadBitmap(quadKey).data;
+  }
+
+  /// Calls action with snapshot of tile bitmap outside of container lock.
+  void readBitmap(const QuadKey &quadKey, const std::function<void(const BitmapIndex::Bitmap &)> &action) {
+    auto bitmap = getBitmap(quadKey);
+    action(*bitmap);
+  }
+
+  /// Removes orders of tile elements which do not intersect given bounding box.
+  void filterByBounds(const QuadKey &quadKey, const BoundingBox &bbox, std::vector<std::uint32_t> &orders) {
+    std::lock_guard<std::mutex> lock(lock_);
+    const auto &bounds = loadBitmap(quadKey).bounds;
+    orders.erase(std::remove_if(orders.begin(), orders.end(), [&](std::uint32_t order) {
+      return !intersects(bounds, order, bbox);
+    }), orders.end());
+  }
+
+  /// Appends elements record of tile. Index entries should contain
+  /// element offsets relative to the beginning of given data.
+  void append(const QuadKey &quadKey,
+              std::uint32_t count,
+              const std::vector<char> &index,
+              const std::string &data,
+              const std::vector<BoundingBox> &bounds,
+              const BitmapAction &updateBitmap) {
+    auto payload = createPayload(isCompressed_, count, index, data);
+    auto size = static_cast<std::uint32_t>(payload.size());
+
+    std::lock_guard<std::mutex> lock(lock_);
+    auto offset = writeHeader(getElementsType(), quadKey, size);
+    stream_.write(payload.data(), payload.size());
+
+    auto &bitmap = loadBitmap(quadKey);
+    auto order = getTileCount(quadKey);
+    updateBitmap(order, getMutable(bitmap));
+    for (const auto &bbox : bounds)
+      appendBounds(bitmap.bounds, order++, bbox);
+    bitmap.isDirty = true;
+
+    apply(getElementsType(), quadKey, offset, size, count);
+  }
+
+  /// Appends elements record of tile which stays invisible until it is committed.
+  /// Index entries should contain element offsets relative to the beginning of given data.
+  void appendPending(const QuadKey &quadKey,
+                     std::uint32_t count,
+                     const std::vector<char> &index,
+                     const std::string &data) {
+    auto payload = createPayload(isCompressed_, count, index, data);
+    auto size = static_cast<std::uint32_t>(payload.size());
+
+    std::lock_guard<std::mutex> lock(lock_);
+    auto type = isCompressed_ ? RecordType::PendingCompressedElements : RecordType::PendingElements;
+    auto offset = writeHeader(type, quadKey, size);
+    stream_.write(payload.data(), payload.size());
+    pending_.push_back({ quadKey, offset, size, count });
+    ++version_;
+  }
+
+  /// Makes pending records of tile visible in order they were appended and updates its bitmap.
+  void commit(const QuadKey &quadKey,
+              const std::vector<BoundingBox> &bounds,
+              const BitmapAction &updateBitmap) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto &bitmap = loadBitmap(quadKey);
+    auto order = getTileCount(quadKey);
+    auto type = static_cast<std::uint8_t>(getElementsType());
+    for (const auto &chunk : pending_) {
+      if (!(chunk.quadKey == quadKey)) continue;
+
+      // NOTE record becomes valid for scan once its type is replaced.
+      stream_.seekp(static_cast<std::streamoff>(chunk.offset - RecordHeaderSize));
+      stream_.write(reinterpret_cast<const char *>(&type), sizeof(type));
+      apply(getElementsType(), quadKey, chunk.offset, chunk.size, chunk.count);
+    }
+    pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [&](const PendingChunk &chunk) {
+      return chunk.quadKey == quadKey;
+    }), pending_.end());
+
+    updateBitmap(order, getMutable(bitmap));
+    for (const auto &bbox : bounds)
+      appendBounds(bitmap.bounds, order++, bbox);
+    bitmap.isDirty = true;
+  }
+
+  /// Discards pending records. File is truncated if nothing else was written
+  /// after them, otherwise they are left as dead records.
+  void rollback() {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (pending_.empty())
+      return;
+
+    auto start = pending_.front().offset - RecordHeaderSize;
+    std::uint64_t size = 0;
+    for (const auto &chunk : pending_)
+      size += RecordHeaderSize + chunk.size;
+    pending_.clear();
+    ++version_;
+
+    if (start + size != size_ || !truncate(start))
+      deadSize_ += size;
+  }
+
+  /// Marks tile data as deleted. Container file is removed when it has no tiles.
+  void erase(const QuadKey &quadKey) {
+    std::lock_guard<std::mutex> lock(lock_);
+    bitmaps_.erase(quadKey);
+    if (tiles_.find(quadKey) == tiles_.end())
+      return;
+
+    if (tiles_.size() > 1 || !pending_.empty()) {
+      apply(RecordType::Erase, quadKey, writeHeader(RecordType::Erase, quadKey, 0), 0, 0);
+      return;
+    }
+
+    // NOTE views which are still in use keep their mapping.
+    stream_.close();
+    tiles_.clear();
+    bitmaps_.clear();
+    file_ = std::make_shared<MappedFile>();
+    size_ = deadSize_ = 0;
+    chunkCount_ = 0;
+    ++version_;
+    if (std::remove(dataPath_.c_str()))
+      std::cerr << "Cannot erase " << dataPath_ << std::endl;
+    if (generation_ > 0 && std::remove((path_ + GenerationFileExtension).c_str()))
+      std::cerr << "Cannot erase " << path_ << GenerationFileExtension << std::endl;
+    generation_ = 0;
+    dataPath_ = path_;
+  }
+
+  /// Appends modified bitmaps to container.
+  void flush() {
+    std::lock_guard<std::mutex> lock(lock_);
+    flushBitmaps();
+  }
+
+  /// Checks whether container has too much dead records or fragmented tiles.
+  bool needsCompaction() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return pending_.empty() && size_ >= MinCompactionSize &&
+        (deadSize_ > size_ * MaxDeadRatio || chunkCount_ > tiles_.size() * MaxChunksPerTile);
+  }
+
+  /// Rewrites container keeping only live data: chunks of each tile are merged
+  /// into single record and only the latest bitmap is kept. Element orders are
+  /// preserved, so bitmaps stay valid. File of the next generation is written from
+  /// snapshot without blocking readers, then generation file is replaced atomically.
+  /// Replaced file is removed when the last view which maps it is released.
+  /// Returns false if container was modified meanwhile or has pending records.
+  bool compact() {
+    std::map<QuadKey, Tile, QuadKey::Comparator> tiles;
+    std::shared_ptr<const MappedFile> file;
+    std::uint64_t version;
+    std::uint32_t generation;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (!pending_.empty())
+        return false;
+      flushBitmaps();
+      ensureMapped(size_);
+      tiles = tiles_;
+      file = file_;
+      version = version_;
+      generation = generation_ + 1;
+    }
+
+    if (tiles.empty())
+      return true;
+
+    auto compactedPath = getDataPath(path_, generation);
+    std::uint64_t size = 0;
+    std::ofstream out(compactedPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    for (auto &pair : tiles) {
+      auto &tile = pair.second;
+      tile.view.reset();
+      if (!tile.chunks.empty()) {
+        auto recordSize = writeElements(out, pair.first, tile, *file);
+        tile.chunks = { { size + RecordHeaderSize, recordSize, 0, tile.count, isCompressed_ } };
+        size += RecordHeaderSize + recordSize;
+      }
+      if (tile.bitmapSize > 0) {
+        writeRecordHeader(out, RecordType::Bitmap, pair.first, tile.bitmapSize);
+        out.write(file->data() + tile.bitmapOffset, tile.bitmapSize);
+        tile.bitmapOffset = size + RecordHeaderSize;
+        size += RecordHeaderSize + tile.bitmapSize;
+      }
+    }
+    out.close();
+    if (out.fail()) {
+      std::remove(compactedPath.c_str());
+      throw std::domain_error("Cannot write " + compactedPath);
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (version != version_) {
+      std::remove(compactedPath.c_str());
+      return false;
+    }
+
+    try {
+      writeGeneration(generation);
+    } catch (...) {
+      std::remove(compactedPath.c_str());
+      throw;
+    }
+
+    // NOTE views which are still in use keep their mapping of replaced file.
+    stream_.close();
+    file_->removeOnRelease(dataPath_);
+    generation_ = generation;
+    dataPath_ = compactedPath;
+
+    tiles_ = std::move(tiles);
+    size_ = size;
+    deadSize_ = 0;
+    chunkCount_ = tiles_.size();
+    ++version_;
+    file_ = std::make_shared<MappedFile>();
+    ensureMapped(size_);
+    return true;
+  }
+
+ private:
+  /// Gets bitmap of tile without synchronization.
+  TileBitmap &loadBitmap(const QuadKey &quadKey) {
+    auto bitmapPair = bitmaps_.find(quadKey);
+    if (bitmapPair != bitmaps_.end())
+      return bitmapPair->second;
+
+    auto &bitmap = bitmaps_[quadKey];
+    auto tile = tiles_.find(quadKey);
+    if (tile != tiles_.end() && tile->second.bitmapSize > 0) {
+      std::string bytes(tile->second.bitmapSize, '\0');
+      std::ifstream file(dataPath_, std::ios::in | std::ios::binary);
+      file.seekg(static_cast<std::streamoff>(tile->second.bitmapOffset));
+      file.read(&bytes[0], bytes.size());
+      // NOTE bitmaps written by older versions have no bounds.
+      std::uint32_t count = 0, marker = 0;
+      if (bytes.size() >= BoundsTrailerSize) {
+        std::memcpy(&count, bytes.data() + bytes.size() - BoundsTrailerSize, sizeof(count));
+        std::memcpy(&marker, bytes.data() + bytes.size() - sizeof(marker), sizeof(marker));
+      }
+      auto boundsSize = static_cast<std::uint64_t>(count) * BoundsSize * sizeof(float);
+      if (marker == BoundsMarker && boundsSize + BoundsTrailerSize <= bytes.size()) {
+        auto bitmapSize = bytes.size() - BoundsTrailerSize - boundsSize;
+        bitmap.bounds.resize(count * BoundsSize);
+        std::memcpy(bitmap.bounds.data(), bytes.data() + bitmapSize, boundsSize);
+        bytes.resize(bitmapSize);
+      }
+
+      std::istringstream in(bytes);
+      BitmapStream::read(in, *bitmap.data);
+    }
+    return bitmap;
+  }
+
+  /// Gets bitmap data of tile for modification copying it if it is shared with snapshots.
+  static BitmapIndex::Bitmap &getMutable(TileBitmap &bitmap) {
+    if (bitmap.data.use_count() > 1)
+      bitmap.data = std::make_shared<BitmapIndex::Bitmap>(*bitmap.data);
+    return *bitmap.data;
+  }
+
+  /// Builds directory by reading record headers.
+  void scan(const MappedFile &file) {
+    std::uint64_t position = 0;
+    while (position + RecordHeaderSize <= file.size()) {
+      std::uint8_t type;
+      std::int32_t tileX, tileY;
+      std::uint32_t size, count = 0;
+      const char *header = file.data() + position;
+      std::memcpy(&type, header, sizeof(type));
+      std::memcpy(&tileX, header + sizeof(type), sizeof(tileX));
+      std::memcpy(&tileY, header + sizeof(type) + sizeof(tileX), sizeof(tileY));
+      std::memcpy(&size, header + sizeof(type) + sizeof(tileX) + sizeof(tileY), sizeof(size));
+
+      auto offset = position + RecordHeaderSize;
+      auto recordType = static_cast<RecordType>(type);
+      // NOTE incomplete record can be left by interrupted write: it is overwritten by next one.
+      if (offset + size > file.size() ||
+          recordType < RecordType::Elements || recordType > RecordType::PendingCompressedElements ||
+          (isElements(recordType) && size < sizeof(count)))
+        break;
+
+      if (isElements(recordType))
+        std::memcpy(&count, file.data() + offset, sizeof(count));
+
+      apply(recordType, QuadKey(levelOfDetail_, tileX, tileY), offset, size, count);
+      position = offset + size;
+    }
+    size_ = position;
+  }
+
+  /// Applies record to directory and tracks space taken by dead records.
+  void apply(RecordType type, const QuadKey &quadKey, std::uint64_t offset, std::uint32_t size, std::uint32_t count) {
+    ++version_;
+    switch (type) {
+      case RecordType::Elements:
+      case RecordType::CompressedElements: {
+        auto &tile = tiles_[quadKey];
+        tile.chunks.push_back({ offset, size, tile.count, count, type == RecordType::CompressedElements });
+        tile.count += count;
+        tile.view.reset();
+        ++chunkCount_;
+        break;
+      }
+      case RecordType::Bitmap: {
+        auto &tile = tiles_[quadKey];
+        if (tile.bitmapSize > 0)
+          deadSize_ += RecordHeaderSize + tile.bitmapSize;
+        tile.bitmapOffset = offset;
+        tile.bitmapSize = size;
+        break;
+      }
+      case RecordType::Erase: {
+        deadSize_ += RecordHeaderSize;
+        auto tile = tiles_.find(quadKey);
+        if (tile == tiles_.end())
+          break;
+        for (const auto &chunk : tile->second.chunks)
+          deadSize_ += RecordHeaderSize + chunk.size;
+        if (tile->second.bitmapSize > 0)
+          deadSize_ += RecordHeaderSize + tile->second.bitmapSize;
+        chunkCount_ -= tile->second.chunks.size();
+        tiles_.erase(tile);
+        break;
+      }
+      case RecordType::PendingElements:
+      case RecordType::PendingCompressedElements:
+        // NOTE transaction was interrupted before commit.
+        deadSize_ += RecordHeaderSize + size;
+        break;
+    }
+  }
+
+  /// Truncates data file to given size without synchronization. Returns false if it is not possible.
+  bool truncate(std::uint64_t size) {
+    using namespace boost::interprocess;
+    stream_.close();
+    if (size == 0) {
+      if (std::remove(dataPath_.c_str()))
+        return false;
+    } else {
+      auto handle = ipcdetail::open_existing_file(dataPath_.c_str(), read_write);
+      if (handle == ipcdetail::invalid_file())
+        return false;
+      auto isTruncated = ipcdetail::truncate_file(handle, static_cast<std::size_t>(size));
+      ipcdetail::close_file(handle);
+      if (!isTruncated)
+        return false;
+    }
+
+    // NOTE views which are still in use keep their mapping.
+    file_ = std::make_shared<MappedFile>();
+    size_ = size;
+    return true;
+  }
+
+  /// Gets amount of elements in tile without synchronization.
+  std::uint32_t getTileCount(const QuadKey &quadKey) const {
+    auto tile = tiles_.find(quadKey);
+    return tile == tiles_.end() ? 0 : tile->second.count;
+  }
+
+  /// Writes dirty bitmaps without synchronization.
+  void flushBitmaps() {
+    for (auto &pair : bitmaps_) {
+      if (!pair.second.isDirty) continue;
+
+      std::ostringstream out;
+      BitmapStream::write(out, *pair.second.data);
+      auto count = static_cast<std::uint32_t>(pair.second.bounds.size() / BoundsSize);
+      out.write(reinterpret_cast<const char *>(pair.second.bounds.data()), count * BoundsSize * sizeof(float));
+      out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+      out.write(reinterpret_cast<const char *>(&BoundsMarker), sizeof(BoundsMarker));
+      auto bytes = out.str();
+      auto size = static_cast<std::uint32_t>(bytes.size());
+      auto offset = writeHeader(RecordType::Bitmap, pair.first, size);
+      stream_.write(bytes.data(), bytes.size());
+
+      apply(RecordType::Bitmap, pair.first, offset, size, 0);
+      pair.second.isDirty = false;
+    }
+
+    if (stream_.is_open())
+      stream_.flush();
+  }
+
+  /// Remaps file if current mapping does not cover given size.
+  void ensureMapped(std::uint64_t size) {
+    if (file_->size() >= size)
+      return;
+
+    stream_.flush();
+    auto file = std::make_shared<MappedFile>();
+    file->map(dataPath_);
+    file_ = file;
+  }
+
+  /// Gets path of data file of given generation.
+  static std::string getDataPath(const std::string &path, std::uint32_t generation) {
+    return generation == 0 ? path : path + "." + std::to_string(generation);
+  }
+
+  /// Reads current generation of container. Missing generation file means the first one.
+  static std::uint32_t readGeneration(const std::string &path) {
+    std::uint32_t generation = 0;
+    std::ifstream file(path + GenerationFileExtension);
+    if (file.good() && !(file >> generation))
+      throw std::domain_error("Cannot read " + path + GenerationFileExtension);
+    return generation;
+  }
+
+  /// Replaces generation file, so container is switched to data file of given generation at once.
+  void writeGeneration(std::uint32_t generation) const {
+    auto generationPath = path_ + GenerationFileExtension;
+    auto tmpPath = generationPath + CompactionFileExtension;
+    std::ofstream file(tmpPath, std::ios::out | std::ios::trunc);
+    file << generation;
+    file.close();
+    if (file.fail()) {
+      std::remove(tmpPath.c_str());
+      throw std::domain_error("Cannot write " + tmpPath);
+    }
+    replaceFile(tmpPath, generationPath);
+  }
+
+  /// Writes record header at the end of valid data. Returns payload offset.
+  std::uint64_t writeHeader(RecordType type, const QuadKey &quadKey, std::uint32_t size) {
+    if (!stream_.is_open()) {
+      // NOTE file should exist in order to be opened for update.
+      std::ofstream(dataPath_, std::ios::out | std::ios::binary | std::ios::app);
+      stream_.open(dataPath_, std::ios::in | std::ios::out | std::ios::binary);
+      if (!stream_.good())
+        throw std::domain_error("Cannot open " + dataPath_);
+    }
+
+    stream_.seekp(static_cast<std::streamoff>(size_));
+    writeRecordHeader(stream_, type, quadKey, size);
+
+    auto offset = size_ + RecordHeaderSize;
+    size_ = offset + size;
+    return offset;
+  }
+
+  static void writeRecordHeader(std::ostream &out, RecordType type, const QuadKey &quadKey, std::uint32_t size) {
+    auto recordType = static_cast<std::uint8_t>(type);
+    auto tileX = static_cast<std::int32_t>(quadKey.tileX);
+    auto tileY = static_cast<std::int32_t>(quadKey.tileY);
+    out.write(reinterpret_cast<const char *>(&recordType), sizeof(recordType));
+    out.write(reinterpret_cast<const char *>(&tileX), sizeof(tileX));
+    out.write(reinterpret_cast<const char *>(&tileY), sizeof(tileY));
+    out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  }
+
+  /// Writes all chunks of tile as single elements record. Returns record payload size.
+  std::uint32_t writeElements(std::ostream &out, const QuadKey &quadKey, const Tile &tile, const MappedFile &file) const {
+    std::vector<char> index;
+    std::string data;
+    index.reserve(tile.count * IndexEntrySize);
+    for (const auto &chunk : tile.chunks)
+      appendChunk(file, chunk, index, data);
 
-// TODO improve thread safety!
+    auto payload = createPayload(isCompressed_, tile.count, index, data);
+    auto size = static_cast<std::uint32_t>(payload.size());
+    writeRecordHeader(out, getElementsType(), quadKey, size);
+    out.write(payload.data(), payload.size());
+    return size;
+  }
+
+  RecordType getElementsType() const {
+    return isCompressed_ ? RecordType::CompressedElements : RecordType::Elements;
+  }
+
+  static bool isElements(RecordType type) {
+    return type == RecordType::Elements || type == RecordType::CompressedElements;
+  }
+
+  const std::string path_;
+  /// Generation of data file.
+  std::uint32_t generation_;
+  /// Path of data file of current generation.
+  std::string dataPath_;
+  const int levelOfDetail_;
+  /// Specifies whether new elements records are compressed.
+  const bool isCompressed_;
+  /// Size of valid data in container file.
+  std::uint64_t size_;
+  /// Size of records which are not used anymore.
+  std::uint64_t deadSize_;
+  /// Total amount of elements records of live tiles.
+  std::size_t chunkCount_;
+  /// Incremented on every modification.
+  std::uint64_t version_;
+  std::shared_ptr<MappedFile> file_;
+  std::map<QuadKey, Tile, QuadKey::Comparator> tiles_;
+  std::map<QuadKey, TileBitmap, QuadKey::Comparator> bitmaps_;
+  /// Records of transaction which is not committed yet.
+  std::vector<PendingChunk> pending_;
+  std::fstream stream_;
+  std::mutex lock_;
+};
+
+/// Keeps large elements which are referenced from many tiles of the same level of detail.
+/// File consists of records with data size and element data, records are never removed:
+/// file is deleted when level of detail has no containers.
+class SharedElements final {
+ public:
+  explicit SharedElements(const std::string &path) :
+      path_(path), file_(), size_(0), stream_(), cache_(SharedCacheSize), lock_() {
+    file_.map(path);
+    size_ = file_.size();
+  }
+
+  SharedElements(const SharedElements &) = delete;
+  SharedElements &operator=(const SharedElements &) = delete;
+
+  /// Appends element data and returns its offset.
+  std::uint64_t append(const std::string &data) {
+    std::string record;
+    appendRecord(record, data);
+    return appendRecords(record);
+  }
+
+  /// Appends records created by appendRecord and returns offset of the first one.
+  std::uint64_t appendRecords(const std::string &records) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!stream_.is_open()) {
+      stream_.open(path_, std::ios::out | std::ios::binary | std::ios::app);
+      if (!stream_.good())
+        throw std::domain_error("Cannot open " + path_);
+    }
+
+    auto offset = size_;
+    stream_.write(records.data(), records.size());
+    size_ += records.size();
+    return offset;
+  }
+
+  /// Adds record with given element data to buffer.
+  static void appendRecord(std::string &buffer, const std::string &data) {
+    appendValue(buffer, static_cast<std::uint32_t>(data.size()));
+    buffer.append(data);
+  }
+
+  /// Gets size of file including data which is not flushed.
+  std::uint64_t size() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return size_;
+  }
+
+  /// Removes records written after given size. Returns false if file cannot be truncated.
+  bool truncate(std::uint64_t size) {
+    using namespace boost::interprocess;
+    std::lock_guard<std::mutex> lock(lock_);
+    if (size >= size_)
+      return true;
+
+    stream_.close();
+    file_.unmap();
+    cache_.clear();
+    auto handle = ipcdetail::open_existing_file(path_.c_str(), read_write);
+    if (handle == ipcdetail::invalid_file())
+      return false;
+    auto isTruncated = ipcdetail::truncate_file(handle, static_cast<std::size_t>(size));
+    ipcdetail::close_file(handle);
+    if (isTruncated)
+      size_ = size;
+    return isTruncated;
+  }
+
+  /// Reads element stored at given offset. Decoded elements are cached as the same
+  /// element is usually requested for many neighbour tiles.
+  std::shared_ptr<const Element> read(std::uint64_t offset, std::uint64_t id) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (cache_.exists(offset))
+      return *cache_.get(offset);
+
+    std::uint32_t size;
+    ensureMapped(offset + sizeof(size));
+    std::memcpy(&size, file_.data() + offset, sizeof(size));
+    ensureMapped(offset + sizeof(size) + size);
+
+    std::shared_ptr<const Element> element = ElementStream::read(file_.data() + offset + sizeof(size), size, id);
+    cache_.put(offset, std::shared_ptr<const Element>(element));
+    return element;
+  }
+
+  /// Writes buffered data to disk.
+  void flush() {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (stream_.is_open())
+      stream_.flush();
+  }
+
+  /// Deletes all elements.
+  void remove() {
+    std::lock_guard<std::mutex> lock(lock_);
+    stream_.close();
+    file_.unmap();
+    cache_.clear();
+    size_ = 0;
+    std::remove(path_.c_str());
+  }
+
+ private:
+  /// Remaps file if current mapping does not cover given size.
+  void ensureMapped(std::uint64_t size) {
+    if (file_.size() >= size)
+      return;
+
+    if (stream_.is_open())
+      stream_.flush();
+    file_.map(path_);
+    if (file_.size() < size)
+      throw std::domain_error("Cannot find shared element data.");
+  }
+
+  const std::string path_;
+  MappedFile file_;
+  std::uint64_t size_;
+  std::ofstream stream_;
+  utymap::utils::LruCache<std::uint64_t, std::shared_ptr<const Element>> cache_;
+  std::mutex lock_;
+};
+
+/// Identifies large element data by element id, data size and its hash.
+struct SharedKey {
+  std::uint64_t id;
+  std::size_t size;
+  std::size_t hash;
+
+  bool operator==(const SharedKey &other) const {
+    return id == other.id && size == other.size && hash == other.hash;
+  }
+};
+
+struct SharedKeyHash {
+  std::size_t operator()(const SharedKey &key) const {
+    return key.hash ^ std::hash<std::uint64_t>()(key.id);
+  }
+};
+
+/// Keeps large element which is stored once and can be moved to shared file when it is stored again.
+struct SharedCandidate {
+  /// Offset in shared file if element is already there.
+  std::uint64_t offset;
+  bool isShared;
+};
+
+/// Buffers shared elements of level of detail added within bulk load transaction.
+struct PendingShared {
+  /// Size of shared file before transaction.
+  std::uint64_t baseSize;
+  /// Size of all records added within transaction.
+  std::uint64_t size;
+  /// Records which are not written to shared file yet.
+  std::string records;
+  /// Specifies whether some records are written to shared file before commit.
+  bool isSpilled;
+};
+
+/// Compacts containers in background thread.
+class Compactor final {
+ public:
+  Compactor() : queue_(), lock_(), signal_(), isStopped_(false), thread_(&Compactor::run, this) {}
+
+  Compactor(const Compactor &) = delete;
+  Compactor &operator=(const Compactor &) = delete;
+
+  ~Compactor() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      isStopped_ = true;
+    }
+    signal_.notify_one();
+    thread_.join();
+  }
+
+  /// Schedules compaction of given container if it is needed.
+  void schedule(const std::shared_ptr<Container> &container) {
+    if (!container->needsCompaction())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (std::find(queue_.begin(), queue_.end(), container) != queue_.end())
+        return;
+      queue_.push_back(container);
+    }
+    signal_.notify_one();
+  }
+
+ private:
+  void run() {
+    while (true) {
+      std::shared_ptr<Container> container;
+      {
+        std::unique_lock<std::mutex> lock(lock_);
+        signal_.wait(lock, [&]() { return isStopped_ || !queue_.empty(); });
+        if (isStopped_) return;
+        container = queue_.front();
+        queue_.pop_front();
+      }
+
+      try {
+        container->compact();
+      } catch (const std::exception &ex) {
+        std::cerr << "Cannot compact container: " << ex.what() << std::endl;
+      }
+    }
+  }
+
+  std::deque<std::shared_ptr<Container>> queue_;
+  std::mutex lock_;
+  std::condition_variable signal_;
+  bool isStopped_;
+  std::thread thread_;
+};
+
+/// Buffers elements of specific quad key saved within bulk load transaction.
+/// Index and data are spilled into container as pending records when buffer grows too much.
+struct PendingData {
+  /// Amount of elements stored in quad key before transaction.
+  std::uint32_t baseCount;
+  /// Amount of elements saved within transaction.
+  std::uint32_t count;
+  /// Amount of elements in index and data which are not spilled yet.
+  std::uint32_t bufferedCount;
+  /// Specifies whether container has pending records of quad key.
+  bool isSpilled;
+  std::vector<char> index;
+  std::ostringstream data;
+  BitmapIndex::Bitmap bitmap;
+  std::vector<BoundingBox> bounds;
+
+  PendingData(std::uint32_t baseCount) :
+      baseCount(baseCount), count(0), bufferedCount(0), isSpilled(false), index(), data(), bitmap(), bounds() {}
+};
+}
+
+/// NOTE search methods can be called concurrently. Storing is expected to be done by single thread.
 class PersistentElementStore::PersistentElementStoreImpl : BitmapIndex {
  public:
   PersistentElementStoreImpl(const std::string &dataPath,
-                             const StringTable &stringTable):
+                             const StringTable &stringTable,
+                             bool compressData,
+                             bool shareElements,
+                             std::size_t maxPendingSize):
     BitmapIndex(stringTable),
     dataPath_(dataPath),
+    compressData_(compressData),
+    shareElements_(shareElements),
+    maxPendingSize_(maxPendingSize),
     lock_(),
-    cache_(12) {}
+    cache_(12),
+    containers_(),
+    filter_(),
+    registered_(),
+    shared_(),
+    candidates_(),
+    pending_(),
+    pendingSize_(0),
+    spilled_(),
+    pendingShared_(),
+    isInTransaction_(false),
+    isFilterDirty_(false),
+    compactor_() {
+    if (compressData && !isCompressionSupported())
+      throw std::domain_error("Data compression requires zlib support.");
+    checkFormat();
+    loadFilter();
+  }
+
+  ~PersistentElementStoreImpl() {
+    try {
+      saveFilter();
+    } catch (const std::exception &ex) {
+      std::cerr << "Cannot save tile filter: " << ex.what() << std::endl;
+    }
+  }
 
   void store(const Element &element, const QuadKey &quadKey) {
-    const auto &quadKeyData = getQuadKeyData(quadKey);
-    auto offset = static_cast<std::uint32_t>(quadKeyData->dataFile->tellg());
-    auto fileSize = quadKeyData->indexFile->tellg();
-    auto order = static_cast<std::uint32_t>(fileSize / (sizeof(element.id) + sizeof(offset)));
+    if (isInTransaction_) {
+      buffer(element, quadKey);
+      return;
+    }
+
+    std::vector<char> index;
+    append(index, element.id);
+    append(index, std::uint32_t(0));
+
+    std::ostringstream data;
+    writeElement(data, element, quadKey);
+
+    // NOTE bitmap is persisted on flush or when container is released.
+    addToFilter(quadKey);
+    getContainer(quadKey)->append(quadKey, 1, index, data.str(), { getBoundingBox(element) },
+      [&](std::uint32_t order, Bitmap &bitmap) {
+        BitmapIndex::add(element, order, bitmap);
+      });
+    registerContainer(quadKey);
+  }
+
+  void begin() {
+    if (isInTransaction_)
+      throw std::domain_error("Bulk load transaction is already started.");
+
+    isInTransaction_ = true;
+  }
 
-    // write element index
-    quadKeyData->indexFile->seekg(0, std::ios::end);
-    quadKeyData->indexFile->write(reinterpret_cast<const char *>(&element.id), sizeof(element.id));
-    quadKeyData->indexFile->write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+  void commit() {
+    // NOTE shared elements are written first, so committed records never refer to missing data.
+    writePendingShared();
 
-    // write element data
-    quadKeyData->dataFile->seekg(0, std::ios::end);
-    ElementStream::write(*quadKeyData->dataFile, element);
+    // NOTE modified containers are kept alive till they are flushed.
+    std::set<std::shared_ptr<Container>> containers;
+    for (auto &pair : pending_) {
+      auto &pending = pair.second;
+      auto container = getContainer(pair.first);
+      containers.insert(container);
+      addToFilter(pair.first);
+      auto updateBitmap = [&](std::uint32_t, Bitmap &bitmap) {
+        for (const auto &entry : pending.bitmap) {
+          auto &bitset = bitmap[entry.first];
+          bitset = bitset.logicalor(entry.second);
+        }
+      };
+      if (pending.isSpilled) {
+        if (pending.bufferedCount > 0)
+          container->appendPending(pair.first, pending.bufferedCount, pending.index, pending.data.str());
+        container->commit(pair.first, pending.bounds, updateBitmap);
+      } else {
+        container->append(pair.first, pending.count, pending.index, pending.data.str(), pending.bounds, updateBitmap);
+      }
+      registerContainer(pair.first);
+    }
+    clearPending();
+
+    // NOTE committed data is persisted completely, so it is visible for other instances.
+    flush();
+  }
+
+  void rollback() {
+    for (const auto &container : spilled_) {
+      container->rollback();
+      compactor_.schedule(container);
+    }
+    for (const auto &pair : pendingShared_) {
+      if (pair.second.isSpilled && !getShared(pair.first)->truncate(pair.second.baseSize))
+        std::cerr << "Cannot truncate shared elements of level " << pair.first << std::endl;
+    }
+    clearPending();
+  }
 
-    // write element search data
-    add(element, quadKey, order);
-    // TODO we always clean/write the whole file here.
-    std::fstream bitmapFile(quadKeyData->getBitmap().path, std::ios::out | std::ios::binary | std::ios::trunc);
-    BitmapStream::write(bitmapFile, quadKeyData->getBitmap().data);
+  std::size_t getPendingSize() const {
+    return pendingSize_;
   }
 
   void search(const BitmapIndex::Query &query,
               ElementVisitor &visitor,
+              SearchPage &page,
               const utymap::CancellationToken &cancelToken) {
-    ElementVisitorFilter filter(visitor, [&](const Element &element) {
+    ElementVisitorFilter pageFilter(visitor, [&](const Element &element) {
+      return page.accept(element);
+    });
+    ElementVisitorFilter filter(pageFilter, [&](const Element &element) {
       return ElementGeometryVisitor::intersects(element, query.boundingBox);
     });
-    BitmapIndex::search(query, filter);
+    BitmapIndex::search(query, filter, page);
   }
 
   void search(const QuadKey &quadKey,
               ElementVisitor &visitor,
               const utymap::CancellationToken &cancelToken) {
-    const auto &quadKeyData = getQuadKeyData(quadKey);
-    auto count = static_cast<std::uint32_t>(quadKeyData->indexFile->tellg() /
-        (sizeof(std::uint64_t) + sizeof(std::uint32_t)));
+    if (!filter_.mayContain(quadKey)) return;
 
-    quadKeyData->indexFile->seekg(0, std::ios::beg);
-    for (std::uint32_t i = 0; i < count; ++i) {
+    auto view = getContainer(quadKey)->getView(quadKey);
+    for (std::uint32_t order = 0; order < view->count; ++order) {
       if (cancelToken.isCancelled()) break;
-
-      auto entry = readIndexEntry(*quadKeyData);
-      quadKeyData->dataFile->seekg(std::get<1>(entry), std::ios::beg);
-
-      ElementStream::read(*quadKeyData->dataFile, std::get<0>(entry ))->accept(visitor);
+      readElement(*view, order, quadKey.levelOfDetail)->accept(visitor);
     }
   }
 
   bool hasData(const QuadKey &quadKey) const override {
-    std::ifstream file(getFilePath(quadKey, DataFileExtension));
-    return file.good();
+    return filter_.mayContain(quadKey) && getContainer(quadKey)->hasTile(quadKey);
   }
 
   void erase(const utymap::QuadKey &quadKey) override {
-    auto quadKeyData = getQuadKeyData(quadKey);
-    {
-      std::lock_guard<std::mutex> lock(lock_);
-      quadKeyData->erase();
-      cache_.clear();
-    }
+    if (!filter_.mayContain(quadKey)) return;
+
+    auto container = getContainer(quadKey);
+    container->erase(quadKey);
+    if (container->isEmpty())
+      unregisterContainer(quadKey);
+    compactor_.schedule(container);
   }
 
   void erase(const utymap::BoundingBox &bbox, const utymap::LodRange &range) {
-    throw std::domain_error("Deletion by bounding box and lod range is not implemented.");
+    std::set<std::shared_ptr<Container>> containers;
+    for (int lod = range.start; lod <= range.end; ++lod) {
+      utymap::utils::GeoUtils::visitTileRange(bbox, lod, [&](const QuadKey &quadKey, const BoundingBox &) {
+        if (!filter_.mayContain(quadKey)) return;
+
+        auto container = getContainer(quadKey);
+        container->erase(quadKey);
+        if (container->isEmpty())
+          unregisterContainer(quadKey);
+        containers.insert(container);
+      });
+    }
+
+    for (const auto &container : containers)
+      compactor_.schedule(container);
   }
 
   void flush() {
-    cache_.clear();
+    for (const auto &container : getContainers()) {
+      container->flush();
+      compactor_.schedule(container);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      for (const auto &pair : shared_)
+        pair.second->flush();
+    }
+    saveFilter();
+  }
+
+  void compact() {
+    for (const auto &container : getContainers())
+      container->compact();
   }
 
  protected:
   void notify(const utymap::QuadKey& quadKey,
               const std::uint32_t order,
               ElementVisitor &visitor) override {
-    auto quadKeyData = getQuadKeyData(quadKey);
-    auto offset = order * (sizeof(std::uint64_t) + sizeof(std::uint32_t));
+    readElement(*getContainer(quadKey)->getView(quadKey), order, quadKey.levelOfDetail)->accept(visitor);
+  }
+
+  /// NOTE cached bitmaps are shared with searches and modified by containers
+  /// under their lock only, so mutable access is not exposed.
+  Bitmap& getBitmap(const utymap::QuadKey&) override {
+    throw std::domain_error("Bitmap of persistent store is modified by its containers only.");
+  }
 
-    quadKeyData->indexFile->seekg(offset, std::ios::beg);
-    auto entry = readIndexEntry(*quadKeyData);
-    quadKeyData->dataFile->seekg(std::get<1>(entry), std::ios::beg);
+  void readBitmap(const utymap::QuadKey& quadKey, const std::function<void(const Bitmap&)> &action) override {
+    getContainer(quadKey)->readBitmap(quadKey, action);
+  }
 
-    ElementStream::read(*quadKeyData->dataFile, std::get<0>(entry))->accept(visitor);
+  void filterByBounds(const utymap::QuadKey &quadKey, const utymap::BoundingBox &bbox, Ids &orders) override {
+    getContainer(quadKey)->filterByBounds(quadKey, bbox, orders);
   }
 
-  Bitmap& getBitmap(const utymap::QuadKey& quadKey) override {
-    return getQuadKeyData(quadKey)->getBitmap().data;
+  void getElementKeys(const utymap::QuadKey &quadKey, const Ids &orders, std::vector<ElementKey> &keys) override {
+    auto view = getContainer(quadKey)->getView(quadKey);
+    keys.reserve(orders.size());
+    for (auto order : orders)
+      keys.push_back(readKey(*view, order));
   }
 
  private:
-  /// Gets quad key data.
-  std::shared_ptr<QuadKeyData> getQuadKeyData(const QuadKey& quadKey) {
+  /// Buffers element in memory till transaction is committed. Buffers are spilled
+  /// into containers when their total size exceeds limit.
+  void buffer(const Element &element, const QuadKey &quadKey) {
+    auto pendingPair = pending_.find(quadKey);
+    if (pendingPair == pending_.end()) {
+      auto baseCount = filter_.mayContain(quadKey) ? getContainer(quadKey)->getCount(quadKey) : 0;
+      pendingPair = pending_.emplace(std::piecewise_construct,
+                                     std::forward_as_tuple(quadKey),
+                                     std::forward_as_tuple(baseCount)).first;
+    }
+
+    auto &pending = pendingPair->second;
+    auto offset = static_cast<std::uint32_t>(pending.data.tellp());
+    auto order = pending.baseCount + pending.count++;
+    ++pending.bufferedCount;
+
+    append(pending.index, element.id);
+    append(pending.index, offset);
+
+    writeElement(pending.data, element, quadKey);
+    BitmapIndex::add(element, order, pending.bitmap);
+    pending.bounds.push_back(getBoundingBox(element));
+
+    pendingSize_ += IndexEntrySize + static_cast<std::size_t>(pending.data.tellp()) - offset;
+    if (pendingSize_ > maxPendingSize_)
+      spill();
+  }
+
+  /// Writes buffered index and data of all quad keys as pending records of their containers.
+  /// Containers are kept alive till the end of transaction as they track pending records.
+  void spill() {
+    writePendingShared();
+    for (auto &pair : pending_) {
+      auto &pending = pair.second;
+      if (pending.bufferedCount == 0) continue;
+
+      auto container = getContainer(pair.first);
+      container->appendPending(pair.first, pending.bufferedCount, pending.index, pending.data.str());
+      spilled_.insert(container);
+      pending.isSpilled = true;
+      pending.bufferedCount = 0;
+      pending.index.clear();
+      pending.data.str(std::string());
+    }
+    pendingSize_ = 0;
+  }
+
+  /// Writes buffered records of shared elements. Their offsets are assigned when they are
+  /// buffered, so shared file should not be modified by anything else within transaction.
+  void writePendingShared() {
+    for (auto &pair : pendingShared_) {
+      auto &pending = pair.second;
+      if (pending.records.empty()) continue;
+
+      auto offset = getShared(pair.first)->appendRecords(pending.records);
+      if (offset + pending.records.size() != pending.baseSize + pending.size)
+        throw std::domain_error("Shared elements are modified within transaction.");
+      pending.records.clear();
+      pending.isSpilled = true;
+    }
+  }
+
+  /// Releases state of finished transaction.
+  void clearPending() {
+    pending_.clear();
+    pendingSize_ = 0;
+    spilled_.clear();
+    pendingShared_.clear();
+    // NOTE candidates can refer to discarded shared records.
+    candidates_.clear();
+    isInTransaction_ = false;
+  }
+
+  /// Gets bounding box of element geometry.
+  static BoundingBox getBoundingBox(const Element &element) {
+    ElementGeometryVisitor visitor;
+    element.accept(visitor);
+    return visitor.boundingBox;
+  }
+
+  /// Appends raw bytes of given value to buffer.
+  template<typename T>
+  static void append(std::vector<char> &buffer, const T &value) {
+    const char *bytes = reinterpret_cast<const char *>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+  }
+
+  /// Gets container which stores data of given quad key.
+  std::shared_ptr<Container> getContainer(const QuadKey& quadKey) const {
+    auto path = getContainerPath(quadKey);
     std::lock_guard<std::mutex> lock(lock_);
 
-    if (cache_.exists(quadKey))
-      return cache_.get(quadKey);
+    if (cache_.exists(path))
+      return *cache_.get(path);
+
+    // NOTE container evicted from cache can be still in use: the same instance
+    // should be reused to avoid concurrent writes into the same file.
+    auto container = containers_[path].lock();
+    if (container == nullptr) {
+      container = std::make_shared<Container>(path, quadKey.levelOfDetail, compressData_);
+      containers_[path] = container;
+    }
+    cache_.put(path, std::shared_ptr<Container>(container));
+
+    for (auto it = containers_.begin(); it != containers_.end();) {
+      if (it->second.expired())
+        it = containers_.erase(it);
+      else
+        ++it;
+    }
+
+    return container;
+  }
 
-    cache_.put(quadKey, std::move(QuadKeyData(getFilePath(quadKey, DataFileExtension),
-                                              getFilePath(quadKey, IndexFileExtension),
-                                              getFilePath(quadKey, bitmapFileExtension))));
+  /// Gets all containers which are currently in use.
+  std::vector<std::shared_ptr<Container>> getContainers() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::vector<std::shared_ptr<Container>> containers;
+    for (const auto &pair : containers_) {
+      auto container = pair.second.lock();
+      if (container != nullptr)
+        containers.push_back(container);
+    }
+    return containers;
+  }
 
-    return cache_.get(quadKey);
+  /// Gets full path of container file for given quad key.
+  std::string getContainerPath(const QuadKey &quadKey) const {
+    return getLodPath(quadKey.levelOfDetail) + getContainerName(quadKey);
   }
 
-  /// Gets full file path for given quad key
-  std::string getFilePath(const QuadKey &quadKey, const std::string &extension) const {
+  /// Gets name of container file for given quad key.
+  static std::string getContainerName(const QuadKey &quadKey) {
+    int parentLevel = std::max(0, quadKey.levelOfDetail - PackDepth);
+    int shift = quadKey.levelOfDetail - parentLevel;
+    QuadKey parent(parentLevel, quadKey.tileX >> shift, quadKey.tileY >> shift);
+    return ContainerFilePrefix + GeoUtils::quadKeyToString(parent) + ContainerFileExtension;
+  }
+
+  /// Gets path of directory with containers of given level of detail.
+  std::string getLodPath(int levelOfDetail) const {
     std::stringstream ss;
-    ss << dataPath_ << "/" << quadKey.levelOfDetail << "/" <<
-      GeoUtils::quadKeyToString(quadKey) << extension;
+    ss << dataPath_ << "/" << levelOfDetail << "/";
     return ss.str();
   }
 
-  /// Reads element info from index.
-  std::tuple<std::uint64_t, std::uint32_t> readIndexEntry(const QuadKeyData &quadKeyData) {
+  /// Checks that data directory has current layout. Version is written when
+  /// directory has no data of older layouts.
+  void checkFormat() const {
+    auto formatPath = dataPath_ + "/" + FormatFile;
+    std::ifstream formatFile(formatPath);
+    if (formatFile.good()) {
+      int version = 0;
+      if (!(formatFile >> version) || version != FormatVersion)
+        throw std::domain_error("Unsupported data format version " + std::to_string(version) + " in " + dataPath_);
+      return;
+    }
+
+    for (int lod = 0; lod <= GeoUtils::MaxLevelOfDetails; ++lod) {
+      bool hasLegacyData = false;
+      // NOTE boost filesystem is not used by library, interprocess helper is portable enough.
+      boost::interprocess::ipcdetail::for_each_file_in_dir(getLodPath(lod).c_str(),
+        [&](const char *, const char *name) {
+          hasLegacyData |= utymap::utils::endsWith(name, LegacyIndexExtension);
+        });
+      if (hasLegacyData)
+        throw std::domain_error("Data in " + getLodPath(lod) +
+                                " uses old layout with file per tile and should be imported again.");
+    }
+
+    // NOTE data directory can be created later: version is written on the next start then.
+    std::ofstream(formatPath) << FormatVersion;
+  }
+
+  /// Reads lists of containers and presence filter of their tiles. Filter is rebuilt
+  /// from containers if it was not saved after the last modification.
+  void loadFilter() {
+    std::vector<std::pair<std::string, int>> paths;
+    for (int lod = 0; lod <= GeoUtils::MaxLevelOfDetails; ++lod) {
+      std::ifstream list(getLodPath(lod) + ContainerListFile);
+      std::string name;
+      while (std::getline(list, name)) {
+        auto path = getLodPath(lod) + name;
+        if (registered_.insert(path).second && Container::exists(path))
+          paths.emplace_back(path, lod);
+      }
+    }
+
+    std::ifstream filterFile(getFilterPath(), std::ios::in | std::ios::binary);
+    if (filterFile.good() && filter_.read(filterFile))
+      return;
+
+    for (const auto &pair : paths) {
+      auto container = std::make_shared<Container>(pair.first, pair.second, compressData_);
+      for (const auto &quadKey : container->getTiles())
+        filter_.add(quadKey);
+
+      containers_[pair.first] = container;
+      cache_.put(pair.first, std::shared_ptr<Container>(container));
+    }
+    isFilterDirty_ = !paths.empty();
+    saveFilter();
+  }
+
+  /// Adds tile to presence filter. Saved filter is removed before the first
+  /// modification, so it is rebuilt from containers if it is not saved again.
+  void addToFilter(const QuadKey &quadKey) {
+    if (!isFilterDirty_) {
+      std::remove(getFilterPath().c_str());
+      isFilterDirty_ = true;
+    }
+    filter_.add(quadKey);
+  }
+
+  /// Writes presence filter if it was modified. Tiles of saved filter are kept,
+  /// so another store instance cannot hide tiles it does not know about.
+  void saveFilter() {
+    if (!isFilterDirty_)
+      return;
+
+    auto filterPath = getFilterPath();
+    {
+      std::ifstream existing(filterPath, std::ios::in | std::ios::binary);
+      if (existing.good())
+        filter_.read(existing);
+    }
+    auto tmpPath = filterPath + CompactionFileExtension;
+    std::ofstream file(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    filter_.write(file);
+    file.close();
+    if (file.fail()) {
+      std::remove(tmpPath.c_str());
+      throw std::domain_error("Cannot write " + tmpPath);
+    }
+    replaceFile(tmpPath, filterPath);
+    isFilterDirty_ = false;
+  }
+
+  std::string getFilterPath() const {
+    return dataPath_ + "/" + FilterFile;
+  }
+
+  /// Adds container of given quad key to the list of containers if it is not there yet.
+  void registerContainer(const QuadKey &quadKey) {
+    auto path = getContainerPath(quadKey);
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!registered_.insert(path).second)
+      return;
+
+    std::ofstream list(getLodPath(quadKey.levelOfDetail) + ContainerListFile, std::ios::out | std::ios::app);
+    list << getContainerName(quadKey) << std::endl;
+  }
+
+  /// Removes container of given quad key from the list of containers.
+  void unregisterContainer(const QuadKey &quadKey) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (registered_.erase(getContainerPath(quadKey)) == 0)
+      return;
+
+    auto lodPath = getLodPath(quadKey.levelOfDetail);
+    std::stringstream names;
+    for (const auto &path : registered_) {
+      if (path.compare(0, lodPath.size(), lodPath) == 0)
+        names << path.substr(lodPath.size()) << std::endl;
+    }
+
+    auto listPath = lodPath + ContainerListFile;
+    if (names.tellp() > 0) {
+      std::ofstream(listPath, std::ios::out | std::ios::trunc) << names.str();
+      return;
+    }
+
+    // NOTE shared elements are not referenced anymore.
+    std::remove(listPath.c_str());
+    candidates_.erase(quadKey.levelOfDetail);
+    auto shared = shared_.find(quadKey.levelOfDetail);
+    if (shared != shared_.end())
+      shared->second->remove();
+    else
+      std::remove((lodPath + SharedFile).c_str());
+  }
+
+  /// Reads element with given order directly from memory view of container.
+  std::shared_ptr<const Element> readElement(const TileView &view, std::uint32_t order, int levelOfDetail) const {
     std::uint64_t id;
     std::uint32_t offset;
-    quadKeyData.indexFile->read(reinterpret_cast<char *>(&id), sizeof(id));
-    quadKeyData.indexFile->read(reinterpret_cast<char *>(&offset), sizeof(offset));
-    return std::make_tuple(id, offset);
+    auto chunk = readEntry(view, order, id, offset);
+    auto indexSize = chunk->count * IndexEntrySize;
+    const char *payload = view.file->data() + chunk->offset;
+
+    if (chunk->isCompressed) {
+      auto block = view.getBlock(*chunk, offset >> BlockOffsetBits);
+      offset &= (1u << BlockOffsetBits) - 1;
+      if (offset >= block->size())
+        throw std::domain_error("Cannot find element data.");
+      return readElement(block->data() + offset, block->size() - offset, id, levelOfDetail);
+    }
+
+    const char *data = payload + sizeof(std::uint32_t) + indexSize;
+    auto dataSize = chunk->size - sizeof(std::uint32_t) - indexSize;
+    if (offset >= dataSize)
+      throw std::domain_error("Cannot find element data.");
+
+    return readElement(data + offset, dataSize - offset, id, levelOfDetail);
+  }
+
+  /// Reads key of element with given order. Kind is known only if element
+  /// data is stored in place without compression.
+  static ElementKey readKey(const TileView &view, std::uint32_t order) {
+    std::uint64_t id;
+    std::uint32_t offset;
+    auto chunk = readEntry(view, order, id, offset);
+    ElementKey key{ id, ElementKind::Unknown };
+    if (chunk->isCompressed)
+      return key;
+
+    auto indexSize = chunk->count * IndexEntrySize;
+    const char *data = view.file->data() + chunk->offset + sizeof(std::uint32_t) + indexSize;
+    auto dataSize = chunk->size - sizeof(std::uint32_t) - indexSize;
+    if (offset < dataSize && static_cast<unsigned char>(data[offset]) != SharedElementMarker)
+      key.kind = ElementStream::readKind(data + offset, dataSize - offset);
+    return key;
+  }
+
+  /// Reads index entry of element with given order. Returns chunk which contains element.
+  static std::vector<Chunk>::const_iterator readEntry(const TileView &view, std::uint32_t order,
+                                                      std::uint64_t &id, std::uint32_t &offset) {
+    auto chunk = std::upper_bound(view.chunks.begin(), view.chunks.end(), order,
+      [](std::uint32_t value, const Chunk &c) { return value < c.firstOrder; });
+    if (order >= view.count || chunk == view.chunks.begin())
+      throw std::domain_error("Cannot find element in index.");
+    --chunk;
+
+    auto indexSize = chunk->count * IndexEntrySize;
+    if (chunk->offset + chunk->size > view.file->size() ||
+        sizeof(std::uint32_t) + indexSize > chunk->size)
+      throw std::domain_error("Cannot find element in index.");
+
+    const char *entry = view.file->data() + chunk->offset + sizeof(std::uint32_t) +
+                        (order - chunk->firstOrder) * IndexEntrySize;
+    std::memcpy(&id, entry, sizeof(id));
+    std::memcpy(&offset, entry + sizeof(id), sizeof(offset));
+    return chunk;
+  }
+
+  /// Reads element from its data or from shared file if data is reference.
+  std::shared_ptr<const Element> readElement(const char *data, std::size_t size,
+                                             std::uint64_t id, int levelOfDetail) const {
+    if (size == 0 || static_cast<unsigned char>(data[0]) != SharedElementMarker)
+      return ElementStream::read(data, size, id);
+
+    std::uint64_t offset;
+    if (size < 1 + sizeof(offset))
+      throw std::domain_error("Cannot find shared element reference.");
+    std::memcpy(&offset, data + 1, sizeof(offset));
+    return getShared(levelOfDetail)->read(offset, id);
+  }
+
+  /// Writes element data. Large element which is stored again as it is, e.g. unclipped
+  /// element which spans many tiles, is moved to shared file and only referenced.
+  void writeElement(std::ostream &stream, const Element &element, const QuadKey &quadKey) {
+    if (!shareElements_) {
+      ElementStream::write(stream, element);
+      return;
+    }
+
+    std::ostringstream data;
+    ElementStream::write(data, element);
+    auto bytes = data.str();
+    if (bytes.size() < SharedElementMinSize) {
+      stream.write(bytes.data(), bytes.size());
+      return;
+    }
+
+    // NOTE within transaction all large elements are remembered, otherwise only the last one.
+    auto &candidates = candidates_[quadKey.levelOfDetail];
+    SharedKey key{ element.id, bytes.size(), std::hash<std::string>()(bytes) };
+    auto candidate = candidates.find(key);
+    if (candidate == candidates.end()) {
+      if (!isInTransaction_)
+        candidates.clear();
+      candidates.emplace(key, SharedCandidate{ 0, false });
+      stream.write(bytes.data(), bytes.size());
+      return;
+    }
+
+    if (!candidate->second.isShared) {
+      candidate->second.offset = appendShared(quadKey.levelOfDetail, bytes);
+      candidate->second.isShared = true;
+    }
+    stream.put(static_cast<char>(SharedElementMarker));
+    stream.write(reinterpret_cast<const char *>(&candidate->second.offset), sizeof(candidate->second.offset));
+  }
+
+  /// Adds element data to shared file of given level of detail and returns its offset.
+  /// Within transaction, data is buffered till commit.
+  std::uint64_t appendShared(int levelOfDetail, const std::string &data) {
+    if (!isInTransaction_)
+      return getShared(levelOfDetail)->append(data);
+
+    auto pendingPair = pendingShared_.find(levelOfDetail);
+    if (pendingPair == pendingShared_.end())
+      pendingPair = pendingShared_.emplace(levelOfDetail,
+                                           PendingShared{ getShared(levelOfDetail)->size(), 0, {}, false }).first;
+
+    auto &pending = pendingPair->second;
+    auto offset = pending.baseSize + pending.size;
+    auto recordsSize = pending.records.size();
+    SharedElements::appendRecord(pending.records, data);
+    pending.size += pending.records.size() - recordsSize;
+    pendingSize_ += pending.records.size() - recordsSize;
+    return offset;
+  }
+
+  /// Gets shared elements of given level of detail.
+  std::shared_ptr<SharedElements> getShared(int levelOfDetail) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto shared = shared_.find(levelOfDetail);
+    if (shared == shared_.end())
+      shared = shared_.emplace(levelOfDetail,
+                               std::make_shared<SharedElements>(getLodPath(levelOfDetail) + SharedFile)).first;
+    return shared->second;
   }
 
   const std::string dataPath_;
-  std::mutex lock_;
-  utymap::utils::LruCache<QuadKey, QuadKeyData, QuadKey::Comparator> cache_;
+  const bool compressData_;
+  const bool shareElements_;
+  /// Size of index and data buffered by transaction which triggers spilling.
+  const std::size_t maxPendingSize_;
+  mutable std::mutex lock_;
+  /// Limits amount of open containers.
+  mutable utymap::utils::LruCache<std::string, std::shared_ptr<Container>> cache_;
+  /// Tracks all containers alive including evicted ones which are still in use.
+  mutable std::map<std::string, std::weak_ptr<Container>> containers_;
+  /// Keeps tiles with data to avoid accessing containers of empty tiles.
+  TileFilter filter_;
+  /// Paths of containers listed in container list files.
+  std::set<std::string> registered_;
+  /// Shared elements per level of detail.
+  mutable std::map<int, std::shared_ptr<SharedElements>> shared_;
+  /// Large elements stored per level of detail which can be moved to shared file.
+  std::map<int, std::unordered_map<SharedKey, SharedCandidate, SharedKeyHash>> candidates_;
+  std::map<QuadKey, PendingData, QuadKey::Comparator> pending_;
+  /// Size of index and data which are buffered in memory.
+  std::size_t pendingSize_;
+  /// Containers which have pending records of transaction.
+  std::set<std::shared_ptr<Container>> spilled_;
+  /// Shared elements added by transaction per level of detail.
+  std::map<int, PendingShared> pendingShared_;
+  bool isInTransaction_;
+  /// Specifies whether filter has tiles which are not saved.
+  bool isFilterDirty_;
+  /// NOTE should be destroyed first as it uses containers.
+  Compactor compactor_;
 };
 
 PersistentElementStore::PersistentElementStore(const std::string &dataPath,
-                                               const StringTable &stringTable) :
+                                               const StringTable &stringTable,
+                                               bool compressData,
+                                               bool shareElements,
+                                               std::size_t maxPendingSize) :
   ElementStore(stringTable),
-  pimpl_(utymap::utils::make_unique<PersistentElementStoreImpl>(dataPath, stringTable)) {}
+  pimpl_(utymap::utils::make_unique<PersistentElementStoreImpl>(dataPath, stringTable, compressData, shareElements,
+                                                                maxPendingSize)) {}
 
 PersistentElementStore::~PersistentElementStore() {
 }
@@ -252,15 +2078,32 @@ void PersistentElementStore::save(const Element &element, const QuadKey &quadKey
   pimpl_->store(element, quadKey);
 }
 
+void PersistentElementStore::begin() {
+  pimpl_->begin();
+}
+
+void PersistentElementStore::commit() {
+  pimpl_->commit();
+}
+
+void PersistentElementStore::rollback() {
+  pimpl_->rollback();
+}
+
+std::size_t PersistentElementStore::getPendingSize() const {
+  return pimpl_->getPendingSize();
+}
+
 void PersistentElementStore::search(const std::string &notTerms,
                                     const std::string &andTerms,
                                     const std::string &orTerms,
                                     const utymap::BoundingBox &bbox,
                                     const utymap::LodRange &range,
                                     utymap::entities::ElementVisitor &visitor,
+                                    SearchPage &page,
                                     const utymap::CancellationToken &cancelToken) {
   BitmapIndex::Query query = { notTerms, andTerms, orTerms, bbox, range };
-  pimpl_->search(query, visitor, cancelToken);
+  pimpl_->search(query, visitor, page, cancelToken);
 }
 
 void PersistentElementStore::search(const QuadKey &quadKey,
@@ -277,6 +2120,10 @@ void PersistentElementStore::flush() {
   pimpl_->flush();
 }
 
+void PersistentElementStore::compact() {
+  pimpl_->compact();
+}
+
 void PersistentElementStore::erase(const utymap::QuadKey &quadKey) {
   pimpl_->erase(quadKey);
 }
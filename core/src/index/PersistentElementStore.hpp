@@ -5,31 +5,59 @@
 #include "entities/Element.hpp"
 #include "index/ElementStore.hpp"
 
+#include <cstddef>
 #include <memory>
 
 namespace utymap {
 namespace index {
 
 /// Provides API to store elements in persistent store.
+/// Tiles of the same level of detail are packed into shared container files.
+/// Tiles with data are kept in memory filter, so probing empty tiles does not touch disk.
 class PersistentElementStore final : public ElementStore {
  public:
+  /// Creates store. If compression is requested, element data is written
+  /// in independently compressed blocks (requires zlib). If sharing is requested,
+  /// large element stored into many tiles unchanged is written only once per LOD.
+  /// Bulk load keeps at most given amount of bytes in memory, the rest is written
+  /// to disk as records which become visible on commit.
   PersistentElementStore(const std::string &path,
-                         const utymap::index::StringTable &stringTable);
+                         const utymap::index::StringTable &stringTable,
+                         bool compressData = false,
+                         bool shareElements = false,
+                         std::size_t maxPendingSize = 64 * 1024 * 1024);
 
   virtual ~PersistentElementStore();
 
+  using ElementStore::search;
+
   void search(const std::string &notTerms,
               const std::string &andTerms,
               const std::string &orTerms,
               const utymap::BoundingBox &bbox,
               const utymap::LodRange &range,
               utymap::entities::ElementVisitor &visitor,
+              utymap::index::SearchPage &page,
               const utymap::CancellationToken &cancelToken) override;
 
   void search(const utymap::QuadKey &quadKey,
               utymap::entities::ElementVisitor &visitor,
               const utymap::CancellationToken &cancelToken) override;
 
+  /// Starts bulk load: index, data and bitmap writes are buffered
+  /// in memory per quad key and written sequentially on commit. When buffers
+  /// exceed size limit, they are written to disk as records ignored till commit.
+  void begin() override;
+
+  /// Writes remaining buffers and flushes store, so committed data is visible for other instances.
+  void commit() override;
+
+  /// Discards buffers and truncates or marks as deleted records written to disk.
+  void rollback() override;
+
+  /// Returns size of index and element data buffered in memory by current transaction.
+  std::size_t getPendingSize() const;
+
   void save(const utymap::entities::Element &element,
             const utymap::QuadKey &quadKey) override;
 
@@ -40,9 +68,13 @@ class PersistentElementStore final : public ElementStore {
   void erase(const utymap::BoundingBox &bbox,
              const utymap::LodRange &range) override;
 
-  /// Flushes cached internally data.
+  /// Flushes cached internally data, e.g. search bitmaps, to disk.
   void flush();
 
+  /// Rewrites container files without deleted and fragmented records.
+  /// NOTE this is also done in background when it is needed.
+  void compact();
+
  private:
   class PersistentElementStoreImpl;
   std::unique_ptr<PersistentElementStoreImpl> pimpl_;
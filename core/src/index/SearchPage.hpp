@@ -0,0 +1,190 @@
+#ifndef INDEX_SEARCHPAGE_HPP_DEFINED
+#define INDEX_SEARCHPAGE_HPP_DEFINED
+
+#include "QuadKey.hpp"
+#include "entities/Element.hpp"
+#include "index/ElementKey.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_set>
+
+namespace utymap {
+namespace index {
+
+/// Defines page of text search results. Elements are visited in deterministic order:
+/// store, level of details, tile inside bounding box and element order inside tile.
+/// Position of the next element is packed into continuation token, so the next page of
+/// the same query starts where the previous one has stopped without reading elements
+/// of previous pages. Tile is identified by its index in bounding box, so paged query
+/// can cover at most MaxTileCount tiles per level of details.
+/// Element stored in many tiles or levels of details is visited once per page. Pages do
+/// not share visited elements, so such element can be visited again by one of the next
+/// pages: consumer should deduplicate results by element id if it merges pages.
+class SearchPage final {
+ public:
+  /// Token of the first page. It is also returned when there are no more results.
+  static const std::uint64_t Start = 0;
+
+  /// Amount of tiles per level of details which can be represented by continuation token.
+  static const std::uint64_t MaxTileCount = std::uint64_t(1) << 21;
+
+  /// Creates page which visits at most limit elements (zero means no limit)
+  /// after skipping offset elements starting from given continuation token.
+  explicit SearchPage(std::uint32_t limit = 0, std::uint32_t offset = 0, std::uint64_t token = Start) :
+      limit_(limit), offset_(offset), skipped_(0), count_(0),
+      start_(unpack(token)), current_(), hasTile_(false), next_(Start), visited_() {}
+
+  /// Checks whether page has limit, so its position is packed into continuation token.
+  bool isLimited() const {
+    return limit_ > 0;
+  }
+
+  /// Checks whether page has enough elements, so search can stop.
+  bool isFull() const {
+    return limit_ > 0 && count_ >= limit_;
+  }
+
+  /// Checks whether page includes all results, so position does not matter.
+  bool isUnbounded() const {
+    return limit_ == 0 && offset_ == 0 &&
+           std::tie(start_.store, start_.lod, start_.tile, start_.order) ==
+           std::make_tuple(0u, 0u, 0u, 0u);
+  }
+
+  /// Gets token of the next page or Start if there are no more results.
+  std::uint64_t next() const {
+    return next_;
+  }
+
+  /// Enters store with given index. Returns false if store is visited by previous pages.
+  bool enterStore(std::uint32_t store) {
+    current_ = Position{ store, 0, 0, 0 };
+    hasTile_ = false;
+    return store >= start_.store;
+  }
+
+  /// Enters the next tile. All tiles of query bounding box should be entered
+  /// in the same order for every page. Returns false if tile is visited by previous pages.
+  bool enterTile(const utymap::QuadKey &quadKey) {
+    auto lod = static_cast<std::uint32_t>(quadKey.levelOfDetail);
+    current_.tile = hasTile_ && current_.lod == lod ? current_.tile + 1 : 0;
+    current_.lod = lod;
+    current_.order = 0;
+    hasTile_ = true;
+    return std::tie(current_.store, current_.lod, current_.tile) >=
+           std::tie(start_.store, start_.lod, start_.tile);
+  }
+
+  /// Gets first element order to visit in current tile.
+  std::uint32_t firstOrder() const {
+    return std::tie(current_.store, current_.lod, current_.tile) ==
+           std::tie(start_.store, start_.lod, start_.tile) ? start_.order : 0;
+  }
+
+  /// Moves to element with given order in current tile.
+  void moveTo(std::uint32_t order) {
+    current_.order = order;
+  }
+
+  /// Checks whether element with given key is already visited by this page.
+  bool isVisited(const ElementKey &key) const {
+    return key.kind != ElementKind::Unknown && visited_.find(toKey(key)) != visited_.end();
+  }
+
+  /// Reserves space for given amount of elements.
+  void reserve(std::size_t count) {
+    visited_.reserve(visited_.size() + count);
+  }
+
+  /// Accepts element at current position. Returns false if it should not be visited.
+  bool accept(const utymap::entities::Element &element) {
+    if (isFull()) return false;
+    if (!visited_.insert(toKey(ElementKey{ element.id, getKind(element) })).second)
+      return false;
+    if (skipped_ < offset_) {
+      ++skipped_;
+      return false;
+    }
+    if (++count_ == limit_)
+      next_ = pack(Position{ current_.store, current_.lod, current_.tile, current_.order + 1 });
+    return true;
+  }
+
+ private:
+  /// Pair of element id and kind packed into single value.
+  using Key = std::pair<std::uint64_t, std::uint8_t>;
+
+  struct KeyHash {
+    std::size_t operator()(const Key &key) const {
+      return std::hash<std::uint64_t>()(key.first * 4 + key.second);
+    }
+  };
+
+  static Key toKey(const ElementKey &key) {
+    return Key(key.id, static_cast<std::uint8_t>(key.kind));
+  }
+
+  static ElementKind getKind(const utymap::entities::Element &element) {
+    struct KindVisitor : utymap::entities::ElementVisitor {
+      ElementKind kind = ElementKind::Unknown;
+      void visitNode(const utymap::entities::Node &) override { kind = ElementKind::Node; }
+      void visitWay(const utymap::entities::Way &) override { kind = ElementKind::Way; }
+      void visitArea(const utymap::entities::Area &) override { kind = ElementKind::Area; }
+      void visitRelation(const utymap::entities::Relation &) override { kind = ElementKind::Relation; }
+    } visitor;
+    element.accept(visitor);
+    return visitor.kind;
+  }
+
+  /// Bit layout of position inside token: store, level of details, tile index
+  /// and element order. Element order takes all its bits, so any order of tile
+  /// can be represented.
+  static const std::uint32_t StoreBits = 6;
+  static const std::uint32_t LodBits = 5;
+  static const std::uint32_t TileBits = 21;
+  static const std::uint32_t OrderBits = 32;
+
+  struct Position {
+    std::uint32_t store;
+    std::uint32_t lod;
+    /// Index of tile in query bounding box at level of details.
+    std::uint32_t tile;
+    std::uint32_t order;
+  };
+
+  static std::uint64_t pack(const Position &position) {
+    if (position.store >> StoreBits != 0 || position.lod >> LodBits != 0 || position.tile >> TileBits != 0)
+      throw std::domain_error("Search position cannot be represented by continuation token.");
+
+    return (static_cast<std::uint64_t>(position.store) << (LodBits + TileBits + OrderBits)) |
+           (static_cast<std::uint64_t>(position.lod) << (TileBits + OrderBits)) |
+           (static_cast<std::uint64_t>(position.tile) << OrderBits) |
+           position.order;
+  }
+
+  static Position unpack(std::uint64_t token) {
+    return Position{ static_cast<std::uint32_t>(token >> (LodBits + TileBits + OrderBits)),
+                     static_cast<std::uint32_t>(token >> (TileBits + OrderBits)) & ((1u << LodBits) - 1),
+                     static_cast<std::uint32_t>(token >> OrderBits) & ((1u << TileBits) - 1),
+                     static_cast<std::uint32_t>(token) };
+  }
+
+  const std::uint32_t limit_;
+  const std::uint32_t offset_;
+  std::uint32_t skipped_;
+  std::uint32_t count_;
+
+  const Position start_;
+  Position current_;
+  /// Specifies whether tile of current store is entered.
+  bool hasTile_;
+  std::uint64_t next_;
+  std::unordered_set<Key, KeyHash> visited_;
+};
+
+}
+}
+
+#endif // INDEX_SEARCHPAGE_HPP_DEFINED
@@ -1,133 +1,491 @@
 #include "hashing/MurmurHash3.h"
 #include "index/StringTable.hpp"
 #include "utils/CoreUtils.hpp"
-#include "utils/LruCache.hpp"
 
+#include <boost/tokenizer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <mutex>
-#include <unordered_map>
+#include <set>
+#include <vector>
 
 using std::ios;
 using namespace utymap::index;
 
-/// Naive implementation of string table: reads all the time string from file; acquires lock
-/// TODO optimize it to avoid locks and expensive file reads.
-class StringTable::StringTableImpl {
-  typedef std::vector<std::uint32_t> IdList;
-  typedef std::unordered_map<std::uint32_t, IdList> HashIdMap;
+namespace {
+/// Size of memory chunk used to store strings.
+const std::size_t ArenaChunkSize = 1024 * 1024;
+/// Amount of string entries allocated at once.
+const std::uint32_t SegmentBits = 12;
+const std::uint32_t SegmentSize = 1 << SegmentBits;
+/// Max amount of entry segments which limits amount of strings.
+const std::uint32_t MaxSegments = 1 << 16;
+/// Initial capacity of hash index, should be power of two.
+const std::size_t InitialCapacity = 4096;
+/// Defines symbols considered as token delimiters
+const boost::char_separator<char> Separator(" _:;!@#$%^&*(){}[],.?`\\/\"\'");
 
+/// Keeps strings in chunks of memory which are never moved or released before arena.
+class Arena final {
  public:
-  StringTableImpl(const std::string &indexPath, const std::string &dataPath, std::uint32_t seed) :
+  Arena() : chunks_(), current_(nullptr), left_(0) {}
+
+  /// Allocates memory of given size.
+  char *allocate(std::size_t size) {
+    if (size > left_) {
+      auto chunkSize = std::max(size, ArenaChunkSize);
+      chunks_.push_back(std::unique_ptr<char[]>(new char[chunkSize]));
+      current_ = chunks_.back().get();
+      left_ = chunkSize;
+    }
+
+    char *result = current_;
+    current_ += size;
+    left_ -= size;
+    return result;
+  }
+
+  /// Copies given data into arena. Returns pointer to copied data.
+  const char *append(const char *data, std::size_t size) {
+    char *result = allocate(size);
+    if (size > 0)
+      std::memcpy(result, data, size);
+    return result;
+  }
+
+ private:
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  char *current_;
+  std::size_t left_;
+};
+
+/// Describes string stored in arena.
+struct Entry {
+  const char *data;
+  std::uint32_t size;
+  std::uint32_t hash;
+  /// Ids of string tokens stored in arena, might be unaligned.
+  const char *tokens;
+  std::uint32_t tokenCount;
+};
+
+/// Describes token in sorted vocabulary.
+struct Token {
+  const char *data;
+  std::uint32_t size;
+  std::uint32_t id;
+};
+
+/// Orders tokens lexicographically, so tokens with common prefix are adjacent.
+struct TokenLess {
+  bool operator()(const Token &lhs, const Token &rhs) const {
+    int result = std::memcmp(lhs.data, rhs.data, std::min(lhs.size, rhs.size));
+    return result < 0 || (result == 0 && lhs.size < rhs.size);
+  }
+};
+
+/// Keeps data of new strings which is written to files at once.
+struct WriteBuffer {
+  std::string data;
+  std::vector<std::uint32_t> index;
+  std::vector<std::uint32_t> tokens;
+};
+
+/// Open addressing hash index: slot stores id + 1, zero marks empty slot.
+struct HashIndex {
+  const std::size_t capacity;
+  std::unique_ptr<std::atomic<std::uint32_t>[]> slots;
+
+  explicit HashIndex(std::size_t capacity) :
+      capacity(capacity), slots(new std::atomic<std::uint32_t>[capacity]) {
+    for (std::size_t i = 0; i < capacity; ++i)
+      slots[i].store(0, std::memory_order_relaxed);
+  }
+};
+}
+
+/// Keeps all strings in memory: data file is loaded into arena at startup and
+/// new strings are appended to both. Lookups are lock-free: entries and hash
+/// slots are published with release semantic after they are filled, only
+/// inserts are synchronized. Hash index is never modified in place during
+/// resize: new one is published and the old one is kept alive for readers.
+/// Each string also keeps ids of its tokens which are interned as strings too,
+/// so they are computed once per string and persisted in token file.
+class StringTable::StringTableImpl {
+ public:
+  StringTableImpl(const std::string &indexPath, const std::string &dataPath,
+                  const std::string &tokenPath, std::uint32_t seed) :
       indexFile_(indexPath, ios::in | ios::out | ios::binary | ios::ate | ios::app),
-      dataFile_(dataPath, ios::in | ios::out | ios::binary | ios::app),
+      dataFile_(dataPath, ios::in | ios::out | ios::binary | ios::ate | ios::app),
+      tokenPath_(tokenPath),
+      tokenFile_(tokenPath, ios::in | ios::out | ios::binary | ios::ate | ios::app),
       seed_(seed),
-      nextId_(0),
-      map_(),
-      offsets_(),
-      cache_(1024) {
-    nextId_ = static_cast<std::uint32_t>(indexFile_.tellg()/(sizeof(std::uint32_t)*2));
-    if (nextId_ > 0) {
-      std::uint32_t count = nextId_;
-      indexFile_.seekg(0, ios::beg);
-
-      // NOTE reserve some extra size for possible insertions
-      std::size_t capacity = count + 2048;
-      offsets_.reserve(capacity);
-      map_.reserve(capacity);
-
-      for (std::uint32_t i = 0; i < count; ++i) {
-        std::uint32_t hash, offset;
-        indexFile_.read(reinterpret_cast<char *>(&hash), sizeof(hash));
-        indexFile_.read(reinterpret_cast<char *>(&offset), sizeof(offset));
-        offsets_.push_back(offset);
-        map_[hash].push_back(i);
-      }
-    }
+      dataSize_(0),
+      arena_(),
+      segments_(new std::atomic<Entry *>[MaxSegments]),
+      ownedSegments_(),
+      count_(0),
+      index_(),
+      indices_(),
+      vocabulary_(),
+      lock_(),
+      vocabularyLock_() {
+    for (std::uint32_t i = 0; i < MaxSegments; ++i)
+      segments_[i].store(nullptr, std::memory_order_relaxed);
+
+    indices_.push_back(utymap::utils::make_unique<HashIndex>(InitialCapacity));
+    index_.store(indices_.back().get(), std::memory_order_relaxed);
+    load();
   }
 
   std::uint32_t getId(const std::string &str) {
-    std::uint32_t hash;
-    MurmurHash3_x86_32(str.c_str(), static_cast<int>(str.size()), seed_, &hash);
+    const std::string *strings[] = { &str };
+    std::uint32_t id;
+    getIds(strings, 1, &id);
+    return id;
+  }
+
+  void getIds(const std::string *const *strings, std::size_t count, std::uint32_t *ids) {
+    std::vector<std::uint32_t> hashes(count);
+    for (std::size_t i = 0; i < count; ++i)
+      MurmurHash3_x86_32(strings[i]->c_str(), static_cast<int>(strings[i]->size()), seed_, &hashes[i]);
+
+    std::vector<std::size_t> missing;
+    for (std::size_t i = 0; i < count; ++i) {
+      if (!find(*strings[i], hashes[i], ids[i]))
+        missing.push_back(i);
+    }
+    if (missing.empty()) return;
 
-    // TODO avoid lock there
     std::lock_guard<std::mutex> lock(lock_);
-    HashIdMap::iterator hashLookupResult = map_.find(hash);
-    if (hashLookupResult!=map_.end()) {
-      std::string data;
-      for (std::uint32_t id : hashLookupResult->second) {
-        // first check string in cache
-        if (cache_.exists(id) && *cache_.peek(id) == str) {
-          cache_.promote(id);
-          return id;
-        }
-        data.clear();
-        readString(id, data);
-        if (str==data)
-          return id;
-      }
+    WriteBuffer buffer;
+    buffer.index.reserve(missing.size() * 2);
+    for (auto i : missing) {
+      // NOTE string can be added by another thread meanwhile or be duplicated in batch.
+      if (!find(*strings[i], hashes[i], ids[i]))
+        ids[i] = insert(*strings[i], hashes[i], buffer);
     }
+    write(buffer);
+  }
 
-    writeString(hash, str);
-    return nextId_++;
+  std::shared_ptr<std::string> getString(std::uint32_t id) const {
+    if (id >= count_.load(std::memory_order_acquire))
+      return std::make_shared<std::string>();
+
+    const auto &entry = getEntry(id);
+    return std::make_shared<std::string>(entry.data, entry.size);
   }
 
-  std::shared_ptr<std::string> getString(std::uint32_t id) {
-    std::lock_guard<std::mutex> lock(lock_);
-    if (cache_.exists(id))
-      return cache_.get(id);
+  void getStrings(const std::uint32_t *ids, std::size_t count, std::string *strings) const {
+    auto size = count_.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < count; ++i) {
+      if (ids[i] >= size) {
+        strings[i].clear();
+        continue;
+      }
+      const auto &entry = getEntry(ids[i]);
+      strings[i].assign(entry.data, entry.size);
+    }
+  }
 
-    std::string str;
-    readString(id, str);
-    cache_.put(id, std::move(str));
+  void getTokenIds(std::uint32_t id, std::vector<std::uint32_t> &tokenIds) const {
+    if (id >= count_.load(std::memory_order_acquire))
+      return;
+
+    const auto &entry = getEntry(id);
+    auto offset = tokenIds.size();
+    tokenIds.resize(offset + entry.tokenCount);
+    if (entry.tokenCount > 0)
+      std::memcpy(&tokenIds[offset], entry.tokens, entry.tokenCount * sizeof(std::uint32_t));
+  }
 
-    return cache_.get(id);
+  void getPrefixIds(const std::string &prefix, std::vector<std::uint32_t> &ids) const {
+    // NOTE tokens with given prefix form a contiguous range of sorted vocabulary,
+    // so only their ids are read under the lock.
+    std::lock_guard<std::mutex> lock(vocabularyLock_);
+    Token key = { prefix.data(), static_cast<std::uint32_t>(prefix.size()), 0 };
+    for (auto token = vocabulary_.lower_bound(key); token != vocabulary_.end() &&
+         token->size >= key.size && std::memcmp(token->data, key.data, key.size) == 0; ++token)
+      ids.push_back(token->id);
+  }
+
+  static void tokenize(const std::string &str, std::vector<std::string> &tokens) {
+    boost::tokenizer<boost::char_separator<char>> tokenizer(str, Separator);
+    tokens.insert(tokens.end(), tokenizer.begin(), tokenizer.end());
   }
 
  private:
+  /// Reads existing strings into memory.
+  void load() {
+    auto count = static_cast<std::uint32_t>(indexFile_.tellg() / (sizeof(std::uint32_t) * 2));
+    dataSize_ = static_cast<std::uint32_t>(dataFile_.tellg());
+    if (count == 0) return;
+
+    // NOTE one extra byte guarantees that pointer to empty string at the end is valid.
+    char *strings = arena_.allocate(dataSize_ + 1);
+    strings[dataSize_] = '\0';
+    dataFile_.seekg(0, ios::beg);
+    dataFile_.read(strings, dataSize_);
+    dataFile_.clear();
 
-  /// Reads string by id.
-  void readString(std::uint32_t id, std::string &data) {
-    if (id < offsets_.size()) {
-      std::uint32_t offset = offsets_[id];
-      dataFile_.seekg(offset, ios::beg);
-      std::getline(dataFile_, data, '\0');
+    indexFile_.seekg(0, ios::beg);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      std::uint32_t hash, offset;
+      indexFile_.read(reinterpret_cast<char *>(&hash), sizeof(hash));
+      indexFile_.read(reinterpret_cast<char *>(&offset), sizeof(offset));
+
+      std::uint32_t size = 0;
+      if (offset < dataSize_) {
+        auto end = static_cast<const char *>(std::memchr(strings + offset, '\0', dataSize_ - offset));
+        size = static_cast<std::uint32_t>((end == nullptr ? strings + dataSize_ : end) - strings - offset);
+      }
+      publish({ offset < dataSize_ ? strings + offset : strings + dataSize_, size, hash, nullptr, 0 });
     }
+    indexFile_.clear();
+
+    loadTokens(count);
   }
 
-  /// Writes string to index.
-  void writeString(std::uint32_t hash, const std::string &data) {
-    // get offset as file size
-    dataFile_.seekg(0, ios::end);
-    std::uint32_t offset = static_cast<std::uint32_t>(dataFile_.tellg());
+  /// Reads token ids of loaded strings. Token ids of strings which are missing in
+  /// token file (e.g. created by older version) are computed and file is rewritten.
+  void loadTokens(std::uint32_t count) {
+    std::uint32_t id = 0;
+    tokenFile_.seekg(0, ios::beg);
+    std::vector<std::uint32_t> tokenIds;
+    for (; id < count; ++id) {
+      std::uint32_t tokenCount;
+      if (!tokenFile_.read(reinterpret_cast<char *>(&tokenCount), sizeof(tokenCount)))
+        break;
+      tokenIds.resize(tokenCount);
+      if (tokenCount > 0 &&
+          !tokenFile_.read(reinterpret_cast<char *>(tokenIds.data()), tokenCount * sizeof(std::uint32_t)))
+        break;
+      setTokens(id, tokenIds);
+    }
+    tokenFile_.clear();
+    if (id == count) {
+      for (std::uint32_t i = 0; i < count; ++i)
+        addToVocabulary(i);
+      return;
+    }
 
-    // write string
-    dataFile_.seekp(0, ios::end);
-    dataFile_ << data.c_str() << '\0';
+    WriteBuffer buffer;
+    for (; id < count; ++id) {
+      const auto &entry = getEntry(id);
+      std::vector<std::string> newTokens;
+      setTokens(id, tokenize(std::string(entry.data, entry.size), id, count_.load(std::memory_order_relaxed), newTokens));
+      for (const auto &token : newTokens)
+        append(token, hash(token), { count_.load(std::memory_order_relaxed) }, buffer);
+    }
 
-    // write index entry
-    indexFile_.seekp(0, ios::end);
-    indexFile_.write(reinterpret_cast<char *>(&hash), sizeof(hash));
-    indexFile_.write(reinterpret_cast<char *>(&offset), sizeof(offset));
+    buffer.tokens.clear();
+    for (std::uint32_t i = 0; i < count_.load(std::memory_order_relaxed); ++i) {
+      const auto &entry = getEntry(i);
+      buffer.tokens.push_back(entry.tokenCount);
+      auto offset = buffer.tokens.size();
+      buffer.tokens.resize(offset + entry.tokenCount);
+      if (entry.tokenCount > 0)
+        std::memcpy(&buffer.tokens[offset], entry.tokens, entry.tokenCount * sizeof(std::uint32_t));
+    }
+
+    tokenFile_.close();
+    tokenFile_.open(tokenPath_, ios::out | ios::binary | ios::trunc);
+    tokenFile_.close();
+    tokenFile_.open(tokenPath_, ios::in | ios::out | ios::binary | ios::ate | ios::app);
+    write(buffer);
+
+    for (std::uint32_t i = 0; i < count; ++i)
+      addToVocabulary(i);
+  }
+
+  /// Adds string with given id to vocabulary if it is a token.
+  void addToVocabulary(std::uint32_t id) {
+    const auto &entry = getEntry(id);
+    std::uint32_t tokenId;
+    if (entry.tokenCount != 1) return;
+    std::memcpy(&tokenId, entry.tokens, sizeof(tokenId));
+    if (tokenId != id) return;
+
+    std::lock_guard<std::mutex> lock(vocabularyLock_);
+    vocabulary_.insert({ entry.data, entry.size, id });
+  }
+
+  /// Sets token ids of loaded string. Called only during loading.
+  void setTokens(std::uint32_t id, const std::vector<std::uint32_t> &tokenIds) {
+    auto &entry = segments_[id >> SegmentBits].load(std::memory_order_relaxed)[id & (SegmentSize - 1)];
+    entry.tokens = arena_.append(reinterpret_cast<const char *>(tokenIds.data()),
+                                 tokenIds.size() * sizeof(std::uint32_t));
+    entry.tokenCount = static_cast<std::uint32_t>(tokenIds.size());
+  }
+
+  std::uint32_t hash(const std::string &str) const {
+    std::uint32_t result;
+    MurmurHash3_x86_32(str.c_str(), static_cast<int>(str.size()), seed_, &result);
+    return result;
+  }
+
+  /// Looks for string in hash index without synchronization.
+  bool find(const std::string &str, std::uint32_t hash, std::uint32_t &id) const {
+    const HashIndex *index = index_.load(std::memory_order_acquire);
+    for (std::size_t i = hash & (index->capacity - 1);; i = (i + 1) & (index->capacity - 1)) {
+      std::uint32_t slot = index->slots[i].load(std::memory_order_acquire);
+      if (slot == 0)
+        return false;
+
+      const auto &entry = getEntry(slot - 1);
+      if (entry.hash == hash && entry.size == str.size() &&
+          std::memcmp(entry.data, str.data(), str.size()) == 0) {
+        id = slot - 1;
+        return true;
+      }
+    }
+  }
+
+  /// Adds new string followed by its unknown tokens. Should be called under lock.
+  std::uint32_t insert(const std::string &str, std::uint32_t hash, WriteBuffer &buffer) {
+    auto id = count_.load(std::memory_order_relaxed);
+    std::vector<std::string> newTokens;
+    append(str, hash, tokenize(str, id, id + 1, newTokens), buffer);
+    // NOTE token consisting of itself only is token of its own.
+    for (const auto &token : newTokens)
+      append(token, this->hash(token), { count_.load(std::memory_order_relaxed) }, buffer);
+    return id;
+  }
+
+  /// Gets token ids of string with given id. Tokens which are not in table yet are
+  /// added to newTokens and get ids sequentially starting from nextId.
+  std::vector<std::uint32_t> tokenize(const std::string &str, std::uint32_t id, std::uint32_t nextId,
+                                      std::vector<std::string> &newTokens) const {
+    std::vector<std::string> tokens;
+    tokenize(str, tokens);
+
+    std::vector<std::uint32_t> tokenIds;
+    tokenIds.reserve(tokens.size());
+    for (const auto &token : tokens) {
+      std::uint32_t tokenId;
+      if (token == str)
+        tokenId = id;
+      else if (!find(token, hash(token), tokenId)) {
+        auto newToken = std::find(newTokens.begin(), newTokens.end(), token);
+        tokenId = nextId + static_cast<std::uint32_t>(newToken - newTokens.begin());
+        if (newToken == newTokens.end())
+          newTokens.push_back(token);
+      }
+      tokenIds.push_back(tokenId);
+    }
+    return tokenIds;
+  }
+
+  /// Adds new string to memory and its data, index and token entries to buffer. Should be called under lock.
+  std::uint32_t append(const std::string &str, std::uint32_t hash,
+                       const std::vector<std::uint32_t> &tokenIds, WriteBuffer &buffer) {
+    auto size = static_cast<std::uint32_t>(std::strlen(str.c_str()));
+    buffer.data.append(str.c_str(), size + 1);
+    buffer.index.push_back(hash);
+    buffer.index.push_back(dataSize_);
+    buffer.tokens.push_back(static_cast<std::uint32_t>(tokenIds.size()));
+    buffer.tokens.insert(buffer.tokens.end(), tokenIds.begin(), tokenIds.end());
+    dataSize_ += size + 1;
+
+    auto id = publish({ arena_.append(str.c_str(), size + 1), size, hash,
+                        arena_.append(reinterpret_cast<const char *>(tokenIds.data()),
+                                      tokenIds.size() * sizeof(std::uint32_t)),
+                        static_cast<std::uint32_t>(tokenIds.size()) });
+    addToVocabulary(id);
+    return id;
+  }
 
-    map_[hash].push_back(nextId_);
-    offsets_.push_back(offset);
+  /// Writes buffered strings, index and token entries to files. Should be called under lock.
+  void write(const WriteBuffer &buffer) {
+    dataFile_.write(buffer.data.data(), buffer.data.size());
+    dataFile_.flush();
+
+    indexFile_.write(reinterpret_cast<const char *>(buffer.index.data()),
+                     buffer.index.size() * sizeof(std::uint32_t));
+    indexFile_.flush();
+
+    tokenFile_.write(reinterpret_cast<const char *>(buffer.tokens.data()),
+                     buffer.tokens.size() * sizeof(std::uint32_t));
+    tokenFile_.flush();
+  }
+
+  /// Publishes entry and adds it to hash index. Returns its id.
+  std::uint32_t publish(const Entry &entry) {
+    auto id = count_.load(std::memory_order_relaxed);
+    auto segment = id >> SegmentBits;
+    if (segment >= MaxSegments)
+      throw std::domain_error("String table is full.");
+
+    if (segments_[segment].load(std::memory_order_relaxed) == nullptr) {
+      ownedSegments_.push_back(std::unique_ptr<Entry[]>(new Entry[SegmentSize]));
+      segments_[segment].store(ownedSegments_.back().get(), std::memory_order_release);
+    }
+    segments_[segment].load(std::memory_order_relaxed)[id & (SegmentSize - 1)] = entry;
+    count_.store(id + 1, std::memory_order_release);
+
+    HashIndex *index = index_.load(std::memory_order_relaxed);
+    if ((id + 1) * 2 > index->capacity)
+      index = grow(*index);
+    else
+      put(*index, id, entry.hash);
+
+    return id;
+  }
+
+  /// Creates hash index with doubled capacity and publishes it.
+  HashIndex *grow(const HashIndex &index) {
+    auto count = count_.load(std::memory_order_relaxed);
+    indices_.push_back(utymap::utils::make_unique<HashIndex>(index.capacity * 2));
+    HashIndex *newIndex = indices_.back().get();
+    for (std::uint32_t id = 0; id < count; ++id)
+      put(*newIndex, id, getEntry(id).hash);
+
+    index_.store(newIndex, std::memory_order_release);
+    return newIndex;
+  }
+
+  static void put(HashIndex &index, std::uint32_t id, std::uint32_t hash) {
+    std::size_t i = hash & (index.capacity - 1);
+    while (index.slots[i].load(std::memory_order_relaxed) != 0)
+      i = (i + 1) & (index.capacity - 1);
+    index.slots[i].store(id + 1, std::memory_order_release);
+  }
+
+  const Entry &getEntry(std::uint32_t id) const {
+    return segments_[id >> SegmentBits].load(std::memory_order_acquire)[id & (SegmentSize - 1)];
   }
 
   std::fstream indexFile_;
   std::fstream dataFile_;
-  std::uint32_t seed_;
-  std::uint32_t nextId_;
+  const std::string tokenPath_;
+  std::fstream tokenFile_;
+  const std::uint32_t seed_;
+  /// Size of data file.
+  std::uint32_t dataSize_;
 
-  /// TODO think about better data structure alternatives
-  HashIdMap map_;
-  std::vector<std::uint32_t> offsets_;
+  Arena arena_;
+  std::unique_ptr<std::atomic<Entry *>[]> segments_;
+  std::vector<std::unique_ptr<Entry[]>> ownedSegments_;
+  /// Amount of published entries.
+  std::atomic<std::uint32_t> count_;
+
+  /// Current hash index.
+  std::atomic<HashIndex *> index_;
+  /// Keeps all created hash indices as readers can still use old ones.
+  std::vector<std::unique_ptr<HashIndex>> indices_;
+  /// Tokens sorted lexicographically for prefix lookups.
+  std::set<Token, TokenLess> vocabulary_;
 
   std::mutex lock_;
-  utymap::utils::LruCache<std::uint32_t, std::string> cache_;
+  mutable std::mutex vocabularyLock_;
 };
 
 StringTable::StringTable(const std::string &path) :
-    pimpl_(utymap::utils::make_unique<StringTableImpl>(path + "string.idx", path + "string.dat", 0)) {
+    pimpl_(utymap::utils::make_unique<StringTableImpl>(path + "string.idx", path + "string.dat",
+                                                  path + "string.tok", 0)) {
 }
 
 StringTable::~StringTable() {}
@@ -139,3 +497,27 @@ std::uint32_t StringTable::getId(const std::string &str) const {
 std::shared_ptr<std::string> StringTable::getString(std::uint32_t id) const {
   return pimpl_->getString(id);
 }
+
+void StringTable::getIds(const std::vector<const std::string *> &strings, std::vector<std::uint32_t> &ids) const {
+  ids.resize(strings.size());
+  if (!strings.empty())
+    pimpl_->getIds(strings.data(), strings.size(), ids.data());
+}
+
+void StringTable::getStrings(const std::vector<std::uint32_t> &ids, std::vector<std::string> &strings) const {
+  strings.resize(ids.size());
+  if (!ids.empty())
+    pimpl_->getStrings(ids.data(), ids.size(), strings.data());
+}
+
+void StringTable::getTokenIds(std::uint32_t id, std::vector<std::uint32_t> &tokenIds) const {
+  pimpl_->getTokenIds(id, tokenIds);
+}
+
+void StringTable::getPrefixIds(const std::string &prefix, std::vector<std::uint32_t> &ids) const {
+  pimpl_->getPrefixIds(prefix, ids);
+}
+
+void StringTable::tokenize(const std::string &str, std::vector<std::string> &tokens) {
+  StringTableImpl::tokenize(str, tokens);
+}
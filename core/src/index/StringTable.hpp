@@ -4,14 +4,17 @@
 #include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace utymap {
 namespace index {
 
 /// Provides the way to maintain strings.
-/// Index file consists of id-offset pairs where id - string id,
+/// Index file consists of hash-offset pairs where position of pair defines string id,
 /// offset - first character of the string inside data file.
 /// data file contains list of null terminated strings.
+/// Token file contains count-prefixed lists of token ids per string id.
+/// All strings are kept in memory, so lookups are lock-free and do not touch files.
 class StringTable final {
  public:
 
@@ -29,6 +32,22 @@ class StringTable final {
   /// Gets original string by id.
   std::shared_ptr<std::string> getString(std::uint32_t id) const;
 
+  /// Gets ids of given strings: ids[i] is id of *strings[i].
+  /// New strings are appended at once, so lock is taken at most once per batch.
+  void getIds(const std::vector<const std::string *> &strings, std::vector<std::uint32_t> &ids) const;
+
+  /// Gets original strings by ids: strings[i] is string with ids[i].
+  void getStrings(const std::vector<std::uint32_t> &ids, std::vector<std::string> &strings) const;
+
+  /// Appends ids of tokens of string with given id. Tokens are interned when string is added.
+  void getTokenIds(std::uint32_t id, std::vector<std::uint32_t> &tokenIds) const;
+
+  /// Appends ids of all known tokens which start with given prefix in lexicographical order.
+  void getPrefixIds(const std::string &prefix, std::vector<std::uint32_t> &ids) const;
+
+  /// Splits given string into tokens.
+  static void tokenize(const std::string &str, std::vector<std::string> &tokens);
+
  private:
   class StringTableImpl;
   std::unique_ptr<StringTableImpl> pimpl_;
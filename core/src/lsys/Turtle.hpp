@@ -2,6 +2,7 @@
 #define LSYS_TURTLE_HPP_DEFINED
 
 #include <functional>
+#include <string>
 
 namespace utymap {
 namespace lsys {
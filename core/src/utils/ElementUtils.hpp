@@ -12,32 +12,39 @@
 namespace utymap {
 namespace utils {
 
-/// Sets tags to element.
-inline void setTags(const utymap::index::StringTable &stringTable,
-                    utymap::entities::Element &element,
-                    const utymap::formats::Tags &tags) {
-  for (const auto &tag : tags) {
-    std::uint32_t key = stringTable.getId(tag.key);
-    std::uint32_t value = stringTable.getId(tag.value);
-    element.tags.push_back(utymap::entities::Tag(key, value));
-  }
-  // NOTE: tags should be sorted to speed up mapcss styling
-  std::sort(element.tags.begin(), element.tags.end());
-}
-
 /// Convert format specific tags to entity ones.
 inline std::vector<utymap::entities::Tag> convertTags(const utymap::index::StringTable &stringTable,
                                                       const utymap::formats::Tags &tags) {
-  std::vector<utymap::entities::Tag> convertedTags(tags.size());
-  std::transform(tags.begin(), tags.end(), convertedTags.begin(), [&](const utymap::formats::Tag &tag) {
-    return utymap::entities::Tag(stringTable.getId(tag.key), stringTable.getId(tag.value));
-  });
+  // NOTE keys and values are interned in one batch to avoid locking string table per string.
+  std::vector<const std::string *> strings;
+  strings.reserve(tags.size() * 2);
+  for (const auto &tag : tags) {
+    strings.push_back(&tag.key);
+    strings.push_back(&tag.value);
+  }
+  std::vector<std::uint32_t> ids;
+  stringTable.getIds(strings, ids);
+
+  std::vector<utymap::entities::Tag> convertedTags;
+  convertedTags.reserve(tags.size());
+  for (std::size_t i = 0; i < ids.size(); i += 2)
+    convertedTags.push_back(utymap::entities::Tag(ids[i], ids[i + 1]));
 
   std::sort(convertedTags.begin(), convertedTags.end());
 
   return std::move(convertedTags);
 }
 
+/// Sets tags to element.
+inline void setTags(const utymap::index::StringTable &stringTable,
+                    utymap::entities::Element &element,
+                    const utymap::formats::Tags &tags) {
+  auto convertedTags = convertTags(stringTable, tags);
+  element.tags.insert(element.tags.end(), convertedTags.begin(), convertedTags.end());
+  // NOTE: tags should be sorted to speed up mapcss styling
+  std::sort(element.tags.begin(), element.tags.end());
+}
+
 template<typename T>
 std::uint32_t getTagValue(std::uint32_t key,
                           const std::vector<utymap::entities::Tag> &tags,
@@ -61,6 +61,7 @@ struct ExportLibFixture {
     ::disconnect();
     std::remove((std::string(TEST_ASSETS_PATH) + "string.idx").c_str());
     std::remove((std::string(TEST_ASSETS_PATH) + "string.dat").c_str());
+    std::remove((std::string(TEST_ASSETS_PATH) + "string.tok").c_str());
   }
 
   utymap::CancellationToken cancelToken;
@@ -126,7 +127,7 @@ BOOST_AUTO_TEST_CASE(GivenTestData_WhenQuadKeyIsLoaded_ThenSearchFindsElement) {
 
   ::getDataByText(0, "", "Nordbahnhof tram stop", "",
     bbox.minPoint.latitude, bbox.minPoint.longitude, bbox.maxPoint.latitude, bbox.maxPoint.longitude,
-    quadkey.levelOfDetail, quadkey.levelOfDetail,
+    quadkey.levelOfDetail, quadkey.levelOfDetail, 0, 0, 0,
     [](int tag, uint64_t id, const char **tags, int size, const double *vertices,
         int vertexCount, const char **style, int styleSize) {
       isCalled = true;
@@ -146,7 +147,7 @@ BOOST_AUTO_TEST_CASE(GivenTestData_WhenQuadKeyIsLoaded_ThenSearchFindsRelation)
   ::addDataInRange(InMemoryStoreKey, TEST_MAPCSS_DEFAULT, TEST_JSON_FILE, lod, lod, callback, &cancelToken);
 
   ::getDataByText(0, "", "Kremlin Square", "",
-    55.7466, 37.6077, 55.7571, 37.6292, lod, lod,
+    55.7466, 37.6077, 55.7571, 37.6292, lod, lod, 0, 0, 0,
     [](int tag, uint64_t id, const char **tags, int size, const double *vertices,
       int vertexCount, const char **style, int styleSize) {
     isCalled = true;
@@ -0,0 +1,70 @@
+#include "formats/osm/NodeLocationStore.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <limits>
+
+using namespace utymap;
+using namespace utymap::formats;
+
+namespace {
+const double Precision = 1E-7;
+
+void checkLocation(NodeLocationStore &store, std::uint64_t id, const GeoCoordinate &expected) {
+  GeoCoordinate coordinate;
+  BOOST_REQUIRE(store.get(id, coordinate));
+  BOOST_CHECK_CLOSE_FRACTION(coordinate.latitude, expected.latitude, Precision);
+  BOOST_CHECK_CLOSE_FRACTION(coordinate.longitude, expected.longitude, Precision);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(Formats_Osm_NodeLocationStore)
+
+BOOST_AUTO_TEST_CASE(GivenUnsortedLocations_WhenGetFromSparseStore_ThenReturnsLastLocations) {
+  SparseNodeLocationStore store;
+  store.set(5, GeoCoordinate(52.5, 13.4));
+  store.set(1, GeoCoordinate(-33.9, 151.2));
+  store.set(3, GeoCoordinate(0, 0));
+  store.set(1, GeoCoordinate(-90, -180));
+
+  checkLocation(store, 1, GeoCoordinate(-90, -180));
+  checkLocation(store, 3, GeoCoordinate(0, 0));
+  checkLocation(store, 5, GeoCoordinate(52.5, 13.4));
+  GeoCoordinate coordinate;
+  BOOST_CHECK(!store.get(2, coordinate));
+  BOOST_CHECK(!store.get(6, coordinate));
+}
+
+BOOST_AUTO_TEST_CASE(GivenLocationsWithLargeIds_WhenGetFromDenseStore_ThenReturnsLocations) {
+  std::string path;
+  {
+    DenseNodeLocationStore store(".");
+    path = store.path();
+    store.set(0, GeoCoordinate(0, 0));
+    store.set(10, GeoCoordinate(90, 180));
+    store.set(5000000, GeoCoordinate(52.5, 13.4));
+    store.set(std::numeric_limits<std::uint64_t>::max(), GeoCoordinate(-10, -20));
+
+    checkLocation(store, 0, GeoCoordinate(0, 0));
+    checkLocation(store, 10, GeoCoordinate(90, 180));
+    checkLocation(store, 5000000, GeoCoordinate(52.5, 13.4));
+    checkLocation(store, std::numeric_limits<std::uint64_t>::max(), GeoCoordinate(-10, -20));
+    GeoCoordinate coordinate;
+    BOOST_CHECK(!store.get(11, coordinate));
+    BOOST_CHECK(!store.get(6000000, coordinate));
+    // NOTE only touched pages are allocated regardless of id values.
+    BOOST_CHECK(std::ifstream(path, std::ios::binary | std::ios::ate).tellg() < 64 * 1024 * 1024);
+  }
+
+  BOOST_CHECK(!std::ifstream(path).good());
+}
+
+BOOST_AUTO_TEST_CASE(GivenTwoDenseStores_WhenCreate_ThenUseDifferentFiles) {
+  DenseNodeLocationStore first(".");
+  DenseNodeLocationStore second(".");
+
+  BOOST_CHECK(first.path() != second.path());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
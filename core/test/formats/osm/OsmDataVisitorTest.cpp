@@ -1,5 +1,8 @@
+#include "entities/Node.hpp"
 #include "entities/Relation.hpp"
+#include "entities/Way.hpp"
 #include "formats/osm/OsmDataVisitor.hpp"
+#include "utils/CoreUtils.hpp"
 
 #include <boost/test/unit_test.hpp>
 
@@ -21,7 +24,12 @@ struct Formats_Osm_OsmDataVisitorFixture {
               dependencyProvider.getCancellationToken()) {
   }
 
-  bool add(utymap::entities::Element &) { return false; }
+  bool add(utymap::entities::Element &element) {
+    elements.push_back(&element);
+    return true;
+  }
+
+  std::vector<utymap::entities::Element *> elements;
 };
 }
 
@@ -38,4 +46,59 @@ BOOST_AUTO_TEST_CASE(GivenRelationWithRecursion_WhenComplete_ThenDoesNotCrash) {
   visitor.complete();
 }
 
+BOOST_AUTO_TEST_CASE(GivenUntaggedNodes_WhenComplete_ThenOnlyReferencedNodesAreAdded) {
+  Tags noTags = {};
+  Tags tags = {utymap::formats::Tag("highway", "primary")};
+  utymap::GeoCoordinate first(52, 13), second(53, 14);
+  std::vector<std::uint64_t> nodeIds = {1, 2};
+  RelationMembers members = {{2, "n", ""}};
+  visitor.visitNode(1, first, noTags);
+  visitor.visitNode(2, second, noTags);
+  visitor.visitWay(1, nodeIds, tags);
+  visitor.visitRelation(1, members, tags);
+
+  visitor.complete();
+
+  BOOST_REQUIRE_EQUAL(elements.size(), 3);
+  auto relation = dynamic_cast<Relation *>(elements[0]);
+  BOOST_REQUIRE(relation != nullptr);
+  BOOST_REQUIRE_EQUAL(relation->elements.size(), 1);
+  BOOST_CHECK_EQUAL(relation->elements[0]->id, 2);
+  auto node = dynamic_cast<Node *>(elements[1]);
+  BOOST_REQUIRE(node != nullptr);
+  BOOST_CHECK_EQUAL(node->id, 2);
+  auto way = dynamic_cast<Way *>(elements[2]);
+  BOOST_REQUIRE(way != nullptr);
+  BOOST_REQUIRE_EQUAL(way->coordinates.size(), 2);
+  BOOST_CHECK_CLOSE(way->coordinates[1].latitude, 53, 1E-5);
+}
+
+BOOST_AUTO_TEST_CASE(GivenStreamingVisitor_WhenVisitElements_ThenAddsNotMembersAtOnce) {
+  OsmDataVisitor streamingVisitor(*dependencyProvider.getStringTable(),
+                                  std::bind(&Formats_Osm_OsmDataVisitorFixture::add, this, std::placeholders::_1),
+                                  dependencyProvider.getCancellationToken(),
+                                  utymap::utils::make_unique<SparseNodeLocationStore>(),
+                                  true);
+  Tags tags = {utymap::formats::Tag("highway", "primary")};
+  utymap::GeoCoordinate first(52, 13), second(53, 14);
+  std::vector<std::uint64_t> nodeIds = {1, 2};
+  RelationMembers members = {{2, "w", ""}};
+  OsmRelationPass<OsmDataVisitor>(streamingVisitor).visitRelation(1, members, tags);
+  OsmElementPass<OsmDataVisitor> pass(streamingVisitor);
+
+  pass.visitNode(1, first, tags);
+  pass.visitNode(2, second, tags);
+  pass.visitWay(1, nodeIds, tags);
+  pass.visitWay(2, nodeIds, tags);
+
+  BOOST_CHECK_EQUAL(elements.size(), 3);
+  streamingVisitor.complete();
+  BOOST_REQUIRE_EQUAL(elements.size(), 5);
+  auto relation = dynamic_cast<Relation *>(elements[3]);
+  BOOST_REQUIRE(relation != nullptr);
+  BOOST_REQUIRE_EQUAL(relation->elements.size(), 1);
+  BOOST_CHECK_EQUAL(relation->elements[0]->id, 2);
+  BOOST_CHECK_EQUAL(elements[4]->id, 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,17 +1,46 @@
+#include "entities/Way.hpp"
 #include "formats/osm/pbf/OsmPbfParser.hpp"
 #include "formats/osm/CountableOsmDataVisitor.hpp"
+#include "formats/osm/OsmDataVisitor.hpp"
 #include "config.hpp"
+#include "test_utils/DependencyProvider.hpp"
 
 #include <boost/test/unit_test.hpp>
 
 #include <fstream>
+#include <set>
+#include <sstream>
 
 using namespace utymap::formats;
+using namespace utymap::tests;
 
 namespace {
 
+/// Records ids of visited elements in order.
+struct OrderedOsmDataVisitor {
+  std::vector<std::uint64_t> nodes;
+  std::vector<std::uint64_t> ways;
+  std::vector<std::uint64_t> relations;
+
+  std::vector<utymap::entities::Tag> tags;
+
+  void visitNode(uint64_t id, utymap::GeoCoordinate &coordinate, std::vector<utymap::entities::Tag> &tags) {
+    nodes.push_back(id);
+    this->tags.insert(this->tags.end(), tags.begin(), tags.end());
+  }
+
+  void visitWay(uint64_t id, std::vector<uint64_t> &nodeIds, std::vector<utymap::entities::Tag> &tags) {
+    ways.push_back(id);
+  }
+
+  void visitRelation(uint64_t id, RelationMembers &members, std::vector<utymap::entities::Tag> &tags) {
+    relations.push_back(id);
+  }
+};
+
 struct Formats_Osm_Pbf_OsmPbfParserFixture {
   Formats_Osm_Pbf_OsmPbfParserFixture() :
+      dependencyProvider(), parser(*dependencyProvider.getStringTable()),
       istream(TEST_PBF_FILE, std::ios::binary) {
   }
 
@@ -20,6 +49,91 @@ struct Formats_Osm_Pbf_OsmPbfParserFixture {
     google::protobuf::ShutdownProtobufLibrary();
   }
 
+  /// Writes blob of given type with given content to stream.
+  static void writeBlob(std::ostream &stream, const std::string &type, const std::string &content, bool compress) {
+    OSMPBF::Blob blob;
+    if (compress) {
+      std::vector<Bytef> buffer(compressBound(content.size()));
+      uLongf size = buffer.size();
+      compress2(buffer.data(), &size, reinterpret_cast<const Bytef *>(content.data()), content.size(), Z_BEST_SPEED);
+      blob.set_zlib_data(buffer.data(), size);
+      blob.set_raw_size(static_cast<std::int32_t>(content.size()));
+    } else {
+      blob.set_raw(content);
+    }
+    std::string blobData = blob.SerializeAsString();
+
+    OSMPBF::BlobHeader header;
+    header.set_type(type);
+    header.set_datasize(static_cast<std::int32_t>(blobData.size()));
+    std::string headerData = header.SerializeAsString();
+
+    std::uint32_t size = static_cast<std::uint32_t>(headerData.size());
+    char sizeData[4] = { static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+                         static_cast<char>(size >> 8), static_cast<char>(size) };
+    stream.write(sizeData, 4);
+    stream << headerData << blobData;
+  }
+
+  /// Writes block with dense nodes, way and relation which have ids starting from given one.
+  static void writeDataBlock(std::ostream &stream, std::uint64_t firstId, int count, bool compress) {
+    OSMPBF::PrimitiveBlock block;
+    block.mutable_stringtable()->add_s("");
+    auto dense = block.add_primitivegroup()->mutable_dense();
+    for (int i = 0; i < count; ++i) {
+      dense->add_id(i == 0 ? static_cast<std::int64_t>(firstId) : 1);
+      dense->add_lat(i);
+      dense->add_lon(i);
+    }
+    auto way = block.add_primitivegroup()->add_ways();
+    way->set_id(firstId);
+    way->add_refs(static_cast<std::int64_t>(firstId));
+    way->add_refs(1);
+    auto relation = block.add_primitivegroup()->add_relations();
+    relation->set_id(firstId);
+    writeBlob(stream, "OSMData", block.SerializeAsString(), compress);
+  }
+
+  /// Writes block with two tagged nodes at (1, 1) and (10, 10), ways and relations which refer to them.
+  static void writeBoundingBoxBlock(std::ostream &stream) {
+    const std::int64_t Degree = 10000000;
+    OSMPBF::PrimitiveBlock block;
+    block.mutable_stringtable()->add_s("");
+    block.mutable_stringtable()->add_s("name");
+    block.mutable_stringtable()->add_s("value");
+    auto dense = block.add_primitivegroup()->mutable_dense();
+    dense->add_id(1); dense->add_lat(Degree); dense->add_lon(Degree);
+    dense->add_id(1); dense->add_lat(9 * Degree); dense->add_lon(9 * Degree);
+    for (int i = 0; i < 2; ++i) {
+      dense->add_keys_vals(1); dense->add_keys_vals(2); dense->add_keys_vals(0);
+    }
+    auto ways = block.add_primitivegroup();
+    auto way = ways->add_ways();
+    way->set_id(1); way->add_refs(1); way->add_refs(1);
+    way = ways->add_ways();
+    way->set_id(2); way->add_refs(2);
+    auto relations = block.add_primitivegroup();
+    auto relation = relations->add_relations();
+    relation->set_id(1); relation->add_memids(2); relation->add_roles_sid(0);
+    relation->add_types(OSMPBF::Relation::WAY);
+    relation = relations->add_relations();
+    relation->set_id(2); relation->add_memids(1); relation->add_roles_sid(0);
+    relation->add_types(OSMPBF::Relation::NODE);
+    writeBlob(stream, "OSMData", block.SerializeAsString(), false);
+  }
+
+  /// Returns all strings interned by string table.
+  static std::set<std::string> getStrings(const utymap::index::StringTable &stringTable) {
+    std::set<std::string> strings;
+    for (std::uint32_t id = 0;; ++id) {
+      auto str = stringTable.getString(id);
+      if (str->empty()) break;
+      strings.insert(*str);
+    }
+    return strings;
+  }
+
+  DependencyProvider dependencyProvider;
   OsmPbfParser<CountableOsmDataVisitor> parser;
   CountableOsmDataVisitor visitor;
   std::ifstream istream;
@@ -37,4 +151,159 @@ BOOST_AUTO_TEST_CASE(GivenDefaultPbf_WhenParserParse_ThenHasExpectedElementCount
   BOOST_CHECK_EQUAL(visitor.relations, 3064);
 }
 
+BOOST_AUTO_TEST_CASE(GivenManyBlocks_WhenParseWithManyWorkers_ThenVisitsElementsInFileOrder) {
+  const int blocks = 50, count = 100;
+  std::stringstream stream;
+  writeBlob(stream, "OSMHeader", OSMPBF::HeaderBlock().SerializeAsString(), false);
+  for (int i = 0; i < blocks; ++i)
+    writeDataBlock(stream, static_cast<std::uint64_t>(i * count + 1), count, i % 2 == 0);
+  OsmPbfParser<OrderedOsmDataVisitor> orderedParser(*dependencyProvider.getStringTable(), 4);
+  OrderedOsmDataVisitor orderedVisitor;
+
+  orderedParser.parse(stream, orderedVisitor);
+
+  BOOST_REQUIRE_EQUAL(orderedVisitor.nodes.size(), blocks * count);
+  BOOST_REQUIRE_EQUAL(orderedVisitor.ways.size(), blocks);
+  BOOST_REQUIRE_EQUAL(orderedVisitor.relations.size(), blocks);
+  for (std::size_t i = 0; i < orderedVisitor.nodes.size(); ++i)
+    BOOST_REQUIRE_EQUAL(orderedVisitor.nodes[i], i + 1);
+  for (std::size_t i = 0; i < blocks; ++i) {
+    BOOST_CHECK_EQUAL(orderedVisitor.ways[i], i * count + 1);
+    BOOST_CHECK_EQUAL(orderedVisitor.relations[i], i * count + 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GivenCorruptedBlock_WhenParse_ThenThrows) {
+  std::stringstream stream;
+  writeDataBlock(stream, 1, 10, false);
+  writeBlob(stream, "OSMData", "corrupted", true);
+  writeDataBlock(stream, 11, 10, false);
+  OsmPbfParser<OrderedOsmDataVisitor> orderedParser(*dependencyProvider.getStringTable(), 2);
+  OrderedOsmDataVisitor orderedVisitor;
+
+  BOOST_CHECK_THROW(orderedParser.parse(stream, orderedVisitor), std::domain_error);
+}
+
+BOOST_AUTO_TEST_CASE(GivenBoundingBox_WhenParse_ThenVisitsOnlyElementsInside) {
+  std::stringstream stream;
+  writeBoundingBoxBlock(stream);
+  OsmPbfParser<OrderedOsmDataVisitor> orderedParser(*dependencyProvider.getStringTable(), 2);
+  OrderedOsmDataVisitor orderedVisitor;
+
+  orderedParser.parse(stream, orderedVisitor, utymap::BoundingBox(utymap::GeoCoordinate(0, 0), utymap::GeoCoordinate(5, 5)));
+
+  BOOST_CHECK(orderedVisitor.nodes == std::vector<std::uint64_t>({ 1, 2 }));
+  BOOST_CHECK_EQUAL(orderedVisitor.tags.size(), 1);
+  BOOST_CHECK(orderedVisitor.ways == std::vector<std::uint64_t>({ 1 }));
+  BOOST_CHECK(orderedVisitor.relations == std::vector<std::uint64_t>({ 2 }));
+}
+
+BOOST_AUTO_TEST_CASE(GivenWayCrossingBoundingBox_WhenParse_ThenWayKeepsNodesOutside) {
+  std::stringstream stream;
+  writeBoundingBoxBlock(stream);
+  const auto &stringTable = *dependencyProvider.getStringTable();
+  std::vector<utymap::entities::Element *> elements;
+  OsmDataVisitor dataVisitor(stringTable, [&](utymap::entities::Element &element) {
+    elements.push_back(&element);
+    return true;
+  }, dependencyProvider.getCancellationToken());
+  OsmPbfParser<OsmDataVisitor> dataParser(stringTable, 2);
+
+  dataParser.parse(stream, dataVisitor, utymap::BoundingBox(utymap::GeoCoordinate(0, 0), utymap::GeoCoordinate(5, 5)));
+  dataVisitor.complete();
+
+  auto way = std::find_if(elements.begin(), elements.end(), [](utymap::entities::Element *element) {
+    return dynamic_cast<utymap::entities::Way *>(element) != nullptr;
+  });
+  BOOST_REQUIRE(way != elements.end());
+  const auto &coordinates = static_cast<utymap::entities::Way *>(*way)->coordinates;
+  BOOST_REQUIRE_EQUAL(coordinates.size(), 2);
+  BOOST_CHECK_CLOSE(coordinates[0].latitude, 1, 1E-5);
+  BOOST_CHECK_CLOSE(coordinates[1].latitude, 10, 1E-5);
+  BOOST_CHECK_CLOSE(coordinates[1].longitude, 10, 1E-5);
+}
+
+BOOST_AUTO_TEST_CASE(GivenHeaderOutsideBoundingBox_WhenParse_ThenVisitsNothing) {
+  const std::int64_t Degree = 1000000000;
+  std::stringstream stream;
+  OSMPBF::HeaderBlock header;
+  header.mutable_bbox()->set_left(0);
+  header.mutable_bbox()->set_bottom(0);
+  header.mutable_bbox()->set_right(20 * Degree);
+  header.mutable_bbox()->set_top(20 * Degree);
+  writeBlob(stream, "OSMHeader", header.SerializeAsString(), true);
+  writeBoundingBoxBlock(stream);
+  OsmPbfParser<OrderedOsmDataVisitor> orderedParser(*dependencyProvider.getStringTable(), 2);
+  OrderedOsmDataVisitor orderedVisitor;
+
+  orderedParser.parse(stream, orderedVisitor, utymap::BoundingBox(utymap::GeoCoordinate(30, 30), utymap::GeoCoordinate(40, 40)));
+
+  BOOST_CHECK(orderedVisitor.nodes.empty());
+  BOOST_CHECK(orderedVisitor.ways.empty());
+}
+
+BOOST_AUTO_TEST_CASE(GivenBoundingBox_WhenParse_ThenInternsOnlyTagsOfKeptElements) {
+  const std::int64_t Degree = 10000000;
+  std::stringstream stream;
+  OSMPBF::PrimitiveBlock block;
+  for (const auto &str : { "", "name", "inside", "outside", "far", "dropped", "way", "inner", "someone" })
+    block.mutable_stringtable()->add_s(str);
+  auto dense = block.add_primitivegroup()->mutable_dense();
+  dense->add_id(1); dense->add_lat(Degree); dense->add_lon(Degree);
+  dense->add_id(1); dense->add_lat(9 * Degree); dense->add_lon(9 * Degree);
+  for (auto index : { 1, 2, 0, 3, 4, 0 })
+    dense->add_keys_vals(index);
+  dense->mutable_denseinfo()->add_user_sid(8);
+  dense->mutable_denseinfo()->add_user_sid(0);
+  auto ways = block.add_primitivegroup();
+  auto way = ways->add_ways();
+  way->set_id(1); way->add_refs(1); way->add_keys(1); way->add_vals(2);
+  way = ways->add_ways();
+  way->set_id(2); way->add_refs(2); way->add_keys(5); way->add_vals(6);
+  auto relation = block.add_primitivegroup()->add_relations();
+  relation->set_id(1); relation->add_memids(2); relation->add_roles_sid(7);
+  relation->add_types(OSMPBF::Relation::WAY);
+  relation->add_keys(5); relation->add_vals(6);
+  writeBlob(stream, "OSMData", block.SerializeAsString(), false);
+  const auto &stringTable = *dependencyProvider.getStringTable();
+  OsmPbfParser<OrderedOsmDataVisitor> orderedParser(stringTable, 2);
+  OrderedOsmDataVisitor orderedVisitor;
+
+  orderedParser.parse(stream, orderedVisitor, utymap::BoundingBox(utymap::GeoCoordinate(0, 0), utymap::GeoCoordinate(5, 5)));
+
+  BOOST_CHECK(orderedVisitor.ways == std::vector<std::uint64_t>({ 1 }));
+  BOOST_CHECK(orderedVisitor.relations.empty());
+  auto strings = getStrings(stringTable);
+  BOOST_CHECK(strings.count("name") == 1 && strings.count("inside") == 1);
+  for (const auto &str : { "outside", "far", "dropped", "way", "inner", "someone" })
+    BOOST_CHECK_MESSAGE(strings.count(str) == 0, str);
+}
+
+BOOST_AUTO_TEST_CASE(GivenTaggedNode_WhenParse_ThenVisitsTagsAsSortedStringIds) {
+  std::stringstream stream;
+  OSMPBF::PrimitiveBlock block;
+  for (const auto &str : { "", "highway", "primary", "amenity", "cafe" })
+    block.mutable_stringtable()->add_s(str);
+  auto dense = block.add_primitivegroup()->mutable_dense();
+  dense->add_id(1); dense->add_lat(0); dense->add_lon(0);
+  for (auto index : { 3, 4, 1, 2, 0 })
+    dense->add_keys_vals(index);
+  writeBlob(stream, "OSMData", block.SerializeAsString(), false);
+  const auto &stringTable = *dependencyProvider.getStringTable();
+  OsmPbfParser<OrderedOsmDataVisitor> orderedParser(stringTable, 2);
+  OrderedOsmDataVisitor orderedVisitor;
+
+  orderedParser.parse(stream, orderedVisitor);
+
+  std::vector<utymap::entities::Tag> expected = {
+    utymap::entities::Tag(stringTable.getId("highway"), stringTable.getId("primary")),
+    utymap::entities::Tag(stringTable.getId("amenity"), stringTable.getId("cafe")) };
+  std::sort(expected.begin(), expected.end());
+  BOOST_REQUIRE_EQUAL(orderedVisitor.tags.size(), 2);
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    BOOST_CHECK_EQUAL(orderedVisitor.tags[i].key, expected[i].key);
+    BOOST_CHECK_EQUAL(orderedVisitor.tags[i].value, expected[i].value);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
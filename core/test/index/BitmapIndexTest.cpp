@@ -225,4 +225,55 @@ BOOST_AUTO_TEST_CASE(GivenElement_WhenQueryWithPartiallyValidAndRule_ThenHasNoRe
   BOOST_CHECK_EQUAL(this->visitedElements.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(GivenThreeElements_WhenQueryWithAndTermsFromCommonToRare_ThenOneResult) {
+  BitmapIndex::Query query = { "", "addr city Berlin", "", bbox, lodRange };
+  addThreeElements();
+
+  index.search(query, *this);
+
+  BOOST_CHECK_EQUAL(this->visitedElements.size(), 1);
+  BOOST_CHECK_EQUAL(getString(this->visitedElements[0]->tags[0].key), "addr:city");
+}
+
+BOOST_AUTO_TEST_CASE(GivenThreeElements_WhenQueryWithDisjointAndTerms_ThenHasNoResult) {
+  BitmapIndex::Query query = { "", "addr country Berlin", "", bbox, lodRange };
+  addThreeElements();
+
+  index.search(query, *this);
+
+  BOOST_CHECK_EQUAL(this->visitedElements.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(GivenThreeElements_WhenQueryWithAndPrefix_ThenOneResult) {
+  BitmapIndex::Query query = { "", "addr Eichen*", "", bbox, lodRange };
+  addThreeElements();
+
+  index.search(query, *this);
+
+  BOOST_CHECK_EQUAL(this->visitedElements.size(), 1);
+  BOOST_CHECK_EQUAL(getString(this->visitedElements[0]->tags[0].key), "addr:street");
+}
+
+BOOST_AUTO_TEST_CASE(GivenThreeElements_WhenQueryWithPrefixMatchingTwoTokensAndNot_ThenOneResult) {
+  BitmapIndex::Query query = { "Ber*", "c*", "", bbox, lodRange };
+  addThreeElements();
+
+  index.search(query, *this);
+
+  BOOST_CHECK_EQUAL(this->visitedElements.size(), 1);
+  BOOST_CHECK_EQUAL(getString(this->visitedElements[0]->tags[0].key), "addr:country");
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyTokensWithSamePrefix_WhenQueryWithPrefix_ThenAllResultsFound) {
+  BitmapIndex::Query query = { "", "Platz*", "", bbox, lodRange };
+  for (int i = 0; i < 100; ++i) {
+    auto name = "Platz" + std::to_string(i);
+    addToIndex({ { "name", name.c_str() } });
+  }
+
+  index.search(query, *this);
+
+  BOOST_CHECK_EQUAL(this->visitedElements.size(), 100);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -36,6 +36,7 @@ class TestElementStore : public ElementStore {
               const utymap::BoundingBox &bbox,
               const utymap::LodRange &range,
               utymap::entities::ElementVisitor &visitor,
+              utymap::index::SearchPage &page,
               const utymap::CancellationToken &cancelToken)  override {}
 
   void search(const QuadKey &, ElementVisitor &, const CancellationToken &) override {}
@@ -0,0 +1,116 @@
+#include "entities/Node.hpp"
+#include "entities/Way.hpp"
+#include "entities/Relation.hpp"
+#include "index/ElementStream.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+
+using namespace utymap;
+using namespace utymap::entities;
+using namespace utymap::index;
+
+namespace {
+/// Writes value as it is done by v1 format.
+template<typename T>
+void writeRaw(std::ostream &stream, const T &value) {
+  stream.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+std::string write(const Element &element) {
+  std::stringstream stream;
+  ElementStream::write(stream, element);
+  return stream.str();
+}
+
+std::unique_ptr<Element> read(const std::string &data, std::uint64_t id) {
+  return ElementStream::read(data.data(), data.size(), id);
+}
+
+Way createWay() {
+  Way way;
+  way.id = 7;
+  way.tags = { Tag(1, 2), Tag(300, 70000) };
+  way.coordinates = { GeoCoordinate(52.5310045, 13.3876123),
+                      GeoCoordinate(52.5310122, 13.3876456),
+                      GeoCoordinate(-33.8688197, -151.2092955) };
+  return way;
+}
+
+void assertWay(const Way &expected, const Way &actual) {
+  BOOST_CHECK_EQUAL(expected.id, actual.id);
+  BOOST_REQUIRE_EQUAL(expected.tags.size(), actual.tags.size());
+  for (std::size_t i = 0; i < expected.tags.size(); ++i) {
+    BOOST_CHECK_EQUAL(expected.tags[i].key, actual.tags[i].key);
+    BOOST_CHECK_EQUAL(expected.tags[i].value, actual.tags[i].value);
+  }
+  BOOST_REQUIRE_EQUAL(expected.coordinates.size(), actual.coordinates.size());
+  for (std::size_t i = 0; i < expected.coordinates.size(); ++i) {
+    BOOST_CHECK_CLOSE(expected.coordinates[i].latitude, actual.coordinates[i].latitude, 1E-7);
+    BOOST_CHECK_CLOSE(expected.coordinates[i].longitude, actual.coordinates[i].longitude, 1E-7);
+  }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(Index_ElementStream)
+
+BOOST_AUTO_TEST_CASE(GivenWay_WhenWriteAndRead_ThenItIsReadBack) {
+  Way way = createWay();
+
+  auto result = read(write(way), way.id);
+
+  assertWay(way, *dynamic_cast<Way *>(result.get()));
+}
+
+BOOST_AUTO_TEST_CASE(GivenWay_WhenWrite_ThenItIsSmallerThanRawEncoding) {
+  Way way = createWay();
+  std::size_t rawSize = 1 + sizeof(std::uint16_t) + way.tags.size() * sizeof(Tag) +
+      sizeof(std::uint16_t) + way.coordinates.size() * 2 * sizeof(double);
+
+  BOOST_CHECK_LT(write(way).size() * 2, rawSize);
+}
+
+BOOST_AUTO_TEST_CASE(GivenRelationWithNodeAndWay_WhenWriteAndRead_ThenItIsReadBack) {
+  Relation relation;
+  relation.id = 1;
+  relation.tags = { Tag(5, 6) };
+  auto node = std::make_shared<Node>();
+  node->id = 2;
+  node->coordinate = GeoCoordinate(-5.5, 179.9999999);
+  relation.elements.push_back(node);
+  relation.elements.push_back(std::make_shared<Way>(createWay()));
+
+  auto result = read(write(relation), relation.id);
+
+  auto &actual = *dynamic_cast<Relation *>(result.get());
+  BOOST_CHECK_EQUAL(actual.id, 1);
+  BOOST_REQUIRE_EQUAL(actual.elements.size(), 2);
+  auto &actualNode = *dynamic_cast<Node *>(actual.elements[0].get());
+  BOOST_CHECK_EQUAL(actualNode.id, 2);
+  BOOST_CHECK_EQUAL(actualNode.coordinate.latitude, -5.5);
+  BOOST_CHECK_EQUAL(actualNode.coordinate.longitude, 179.9999999);
+  assertWay(createWay(), *dynamic_cast<Way *>(actual.elements[1].get()));
+}
+
+BOOST_AUTO_TEST_CASE(GivenWayInV1Format_WhenRead_ThenItIsReadBack) {
+  Way way = createWay();
+  std::stringstream stream;
+  writeRaw(stream, char(1));
+  writeRaw(stream, static_cast<std::uint16_t>(way.tags.size()));
+  for (const auto &tag : way.tags) {
+    writeRaw(stream, tag.key);
+    writeRaw(stream, tag.value);
+  }
+  writeRaw(stream, static_cast<std::uint16_t>(way.coordinates.size()));
+  for (const auto &coordinate : way.coordinates) {
+    writeRaw(stream, coordinate.latitude);
+    writeRaw(stream, coordinate.longitude);
+  }
+
+  auto result = ElementStream::read(stream, way.id);
+
+  assertWay(way, *dynamic_cast<Way *>(result.get()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
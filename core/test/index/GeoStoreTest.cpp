@@ -1,14 +1,24 @@
+#include "entities/Node.hpp"
+#include "entities/Way.hpp"
+#include "entities/Area.hpp"
+#include "entities/Relation.hpp"
 #include "index/GeoStore.hpp"
+#include "index/InMemoryElementStore.hpp"
 #include "index/PersistentElementStore.hpp"
 #include "mapcss/MapCssParser.hpp"
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <set>
 #include <thread>
 
 #include "config.hpp"
 #include "test_utils/DependencyProvider.hpp"
+#include "test_utils/ElementUtils.hpp"
 
 using namespace utymap;
 using namespace utymap::index;
@@ -20,10 +30,14 @@ const std::string DataDirectory = "data";
 const std::string TestZoomDirectory = DataDirectory + "/16";
 
 StyleSheet createStylesheet(const std::string &path) {
-  std::ifstream file(TEST_MAPCSS_DEFAULT);
+  std::ifstream file(path);
+  BOOST_REQUIRE_MESSAGE(file.good(), "Cannot open stylesheet: " + path);
   std::string dir = path.substr(0, path.find_last_of("\\/") + 1);
   MapCssParser parser(dir);
-  return parser.parse(file);
+  auto stylesheet = parser.parse(file);
+  // NOTE no element is imported with empty stylesheet, so cancellation never happens.
+  BOOST_REQUIRE(!stylesheet.rules.empty());
+  return stylesheet;
 }
 
 /// Decorates persistent store with additional test logic.
@@ -34,10 +48,10 @@ public:
                            const StringTable &stringTable,
                            CancellationToken &token) :
     ElementStore(stringTable),
-    store_(dataPath, stringTable), token_(token), counter_(0), isErased_(false) {}
+    store_(dataPath, stringTable), token_(token), counter_(0), isRolledBack_(false) {}
 
   void search(const std::string&, const std::string&, const std::string&, const BoundingBox&,
-              const LodRange&, entities::ElementVisitor&, const CancellationToken&) override {
+              const LodRange&, entities::ElementVisitor&, SearchPage&, const CancellationToken&) override {
     throw std::domain_error("Unexpected function call.");
   }
 
@@ -52,14 +66,26 @@ public:
   }
 
   void erase(const QuadKey &quadKey) override {
-    store_.erase(quadKey);
-    isErased_ = true;
+    throw std::domain_error("Unexpected function call.");
   }
 
   void erase(const BoundingBox &bbox, const LodRange &range) override {
     throw std::domain_error("Unexpected function call.");
   }
 
+  void begin() override {
+    store_.begin();
+  }
+
+  void commit() override {
+    store_.commit();
+  }
+
+  void rollback() override {
+    store_.rollback();
+    isRolledBack_ = true;
+  }
+
   void save(const entities::Element &element, const QuadKey &quadKey) override {
     ++counter_;
     store_.save(element, quadKey);
@@ -69,15 +95,39 @@ public:
     }
   }
 
-  void waitForErase() const {
-    while (!isErased_) {}
+  /// Waits until rollback is called, returns false if it did not happen in given time.
+  bool waitForRollback(std::chrono::milliseconds timeout) const {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!isRolledBack_) {
+      if (std::chrono::steady_clock::now() > deadline)
+        return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
   }
 
 private:
   PersistentElementStore store_;
   CancellationToken &token_;
   int counter_;
-  volatile bool isErased_;
+  std::atomic<bool> isRolledBack_;
+};
+
+/// Collects ids of visited elements and threads which have visited them.
+struct ElementIdCollector : public entities::ElementVisitor {
+  std::vector<std::uint64_t> ids;
+  std::set<std::thread::id> threads;
+
+  void visitNode(const entities::Node &node) override { add(node.id); }
+  void visitWay(const entities::Way &way) override { add(way.id); }
+  void visitArea(const entities::Area &area) override { add(area.id); }
+  void visitRelation(const entities::Relation &relation) override { add(relation.id); }
+
+ private:
+  void add(std::uint64_t id) {
+    ids.push_back(id);
+    threads.insert(std::this_thread::get_id());
+  }
 };
 
 struct Index_GeoStoreFixture {
@@ -100,7 +150,7 @@ struct Index_GeoStoreFixture {
 
 BOOST_FIXTURE_TEST_SUITE(Index_GeoStore, Index_GeoStoreFixture)
 
-BOOST_AUTO_TEST_CASE(GivenImportQuadKeyToPersistentStore_WhenAddOperationIsCancelled_ThenAllDataErased) {
+BOOST_AUTO_TEST_CASE(GivenImportQuadKeyToPersistentStore_WhenAddOperationIsCancelled_ThenAllDataRolledBack) {
   // ARRANGE
   QuadKey quadKey(16, 35205, 21489);
   const std::string storeKey = "file_storage";
@@ -115,11 +165,62 @@ BOOST_AUTO_TEST_CASE(GivenImportQuadKeyToPersistentStore_WhenAddOperationIsCance
   t.join();
 
   // ASSERT
-  store->waitForErase();
+  BOOST_REQUIRE(store->waitForRollback(std::chrono::seconds(10)));
   BOOST_ASSERT(!store_.hasData(quadKey));
-  BOOST_ASSERT(!boost::filesystem::exists(TestZoomDirectory + "/1202102332220103.bmp"));
-  BOOST_ASSERT(!boost::filesystem::exists(TestZoomDirectory + "/1202102332220103.dat"));
-  BOOST_ASSERT(!boost::filesystem::exists(TestZoomDirectory + "/1202102332220103.idf"));
+  BOOST_ASSERT(boost::filesystem::is_empty(TestZoomDirectory));
+}
+
+BOOST_AUTO_TEST_CASE(GivenSeveralStoresWithData_WhenSearch_ThenElementsOfAllStoresVisitedOnCallingThread) {
+  const std::uint64_t count = 1000;
+  auto &stringTable = *dependencyProvider.getStringTable();
+  auto &styleProvider = *dependencyProvider.getStyleProvider("node|z1[any] { clip: false; }");
+  BoundingBox bbox(GeoCoordinate(-90, -180), GeoCoordinate(90, 180));
+  for (int i = 0; i < 3; ++i) {
+    auto storeKey = "store" + std::to_string(i);
+    store_.registerStore(storeKey, utymap::utils::make_unique<InMemoryElementStore>(stringTable));
+    for (std::uint64_t id = 0; id < count; ++id) {
+      auto node = ElementUtils::createElement<entities::Node>(stringTable, i * count + id, { { "any", "true" } });
+      node.coordinate = { 5, -5 };
+      store_.add(storeKey, node, LodRange(1, 1), styleProvider, CancellationToken());
+    }
+  }
+  ElementIdCollector quadKeyCollector, textCollector;
+  SearchPage page;
+
+  store_.search(QuadKey(1, 0, 0), styleProvider, quadKeyCollector, CancellationToken());
+  store_.search("", "any", "", bbox, LodRange(1, 1), textCollector, page, CancellationToken());
+
+  // NOTE stores are searched in parallel, so order of elements is not defined.
+  std::sort(quadKeyCollector.ids.begin(), quadKeyCollector.ids.end());
+  std::sort(textCollector.ids.begin(), textCollector.ids.end());
+  BOOST_CHECK_EQUAL(quadKeyCollector.ids.size(), 3 * count);
+  for (std::size_t i = 0; i < quadKeyCollector.ids.size(); ++i)
+    BOOST_REQUIRE_EQUAL(quadKeyCollector.ids[i], i);
+  BOOST_CHECK(textCollector.ids == quadKeyCollector.ids);
+  std::set<std::thread::id> callingThread = { std::this_thread::get_id() };
+  BOOST_CHECK(quadKeyCollector.threads == callingThread);
+  BOOST_CHECK(textCollector.threads == callingThread);
+}
+
+BOOST_AUTO_TEST_CASE(GivenSameElementInSeveralStores_WhenSearchWithAndWithoutPage_ThenElementVisitedOnce) {
+  auto &stringTable = *dependencyProvider.getStringTable();
+  auto &styleProvider = *dependencyProvider.getStyleProvider("node|z1[any] { clip: false; }");
+  BoundingBox bbox(GeoCoordinate(-90, -180), GeoCoordinate(90, 180));
+  for (int i = 0; i < 3; ++i) {
+    auto storeKey = "store" + std::to_string(i);
+    store_.registerStore(storeKey, utymap::utils::make_unique<InMemoryElementStore>(stringTable));
+    auto node = ElementUtils::createElement<entities::Node>(stringTable, 1, { { "any", "true" } });
+    node.coordinate = { 5, -5 };
+    store_.add(storeKey, node, LodRange(1, 1), styleProvider, CancellationToken());
+  }
+  ElementIdCollector unboundedCollector, pagedCollector;
+  SearchPage unboundedPage, page(10);
+
+  store_.search("", "any", "", bbox, LodRange(1, 1), unboundedCollector, unboundedPage, CancellationToken());
+  store_.search("", "any", "", bbox, LodRange(1, 1), pagedCollector, page, CancellationToken());
+
+  BOOST_CHECK(unboundedCollector.ids == std::vector<std::uint64_t>({ 1 }));
+  BOOST_CHECK(pagedCollector.ids == std::vector<std::uint64_t>({ 1 }));
 }
 
 BOOST_AUTO_TEST_SUITE_END()
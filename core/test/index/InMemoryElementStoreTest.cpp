@@ -3,6 +3,7 @@
 #include "entities/Node.hpp"
 #include "entities/Way.hpp"
 #include "entities/Area.hpp"
+#include "entities/Relation.hpp"
 #include "index/InMemoryElementStore.hpp"
 
 #include <boost/test/unit_test.hpp>
@@ -25,11 +26,11 @@ struct Index_InMemoryElementStoreFixture {
       elementStore(*dependencyProvider.getStringTable()),
       styleProvider(*dependencyProvider.getStyleProvider(stylesheet)) {}
 
-  void addTestData() {
+  void addTestData(std::uint64_t id = 0) {
     LodRange range(1, 2);
     elementStore.store(ElementUtils::createElement<Way>(
         *dependencyProvider.getStringTable(),
-        0,
+        id,
         {{"any", "true"}},
         {{5, -5}, {5, -10}}),
                        range,
@@ -37,7 +38,7 @@ struct Index_InMemoryElementStoreFixture {
 
     elementStore.store(ElementUtils::createElement<Area>(
         *dependencyProvider.getStringTable(),
-        0,
+        id,
         {{"any", "true"}, {"area", "yes"}},
         {{5, -5}, {5, -10}, {10, -10}}),
                        range,
@@ -45,7 +46,7 @@ struct Index_InMemoryElementStoreFixture {
 
     Node node = ElementUtils::createElement<Node>(
         *dependencyProvider.getStringTable(),
-        0,
+        id,
         {{"any", "true"}});
 
     node.coordinate = {5, -5};
@@ -65,6 +66,15 @@ struct ElementCounter : public ElementVisitor {
   void visitArea(const Area &) override { ++times; }
   void visitRelation(const Relation &) override { ++times; }
 };
+
+struct RelationCollector : public ElementVisitor {
+  std::vector<Relation> relations;
+
+  void visitNode(const Node &) override {}
+  void visitWay(const Way &) override {}
+  void visitArea(const Area &) override {}
+  void visitRelation(const Relation &relation) override { relations.push_back(relation); }
+};
 }
 
 BOOST_FIXTURE_TEST_SUITE(Index_InMemoryElementStore, Index_InMemoryElementStoreFixture)
@@ -126,4 +136,124 @@ BOOST_AUTO_TEST_CASE(GivenElementWithNonAnsiSymbols_WhenSearchText_ThenItIsFound
   BOOST_CHECK_EQUAL(counter.times, 1);
 }
 
+BOOST_AUTO_TEST_CASE(GivenDataAndRolledBackTransaction_WhenSearch_ThenOnlyDataBeforeTransactionFound) {
+  QuadKey quadKey(1, 0, 0);
+  BoundingBox boundingBox(GeoCoordinate(-90, -180), GeoCoordinate(90, 180));
+  ElementCounter quadKeyCounter, textCounter;
+  addTestData();
+  elementStore.begin();
+  addTestData();
+
+  elementStore.rollback();
+
+  elementStore.search(quadKey, quadKeyCounter, CancellationToken());
+  elementStore.search({}, {"any"}, {}, boundingBox, LodRange(1, 1), textCounter, CancellationToken());
+  BOOST_CHECK_EQUAL(quadKeyCounter.times, 3);
+  BOOST_CHECK_EQUAL(textCounter.times, 3);
+}
+
+BOOST_AUTO_TEST_CASE(GivenData_WhenSearchWithLimitAndContinue_ThenAllElementsFoundOnce) {
+  BoundingBox boundingBox(GeoCoordinate(-90, -180), GeoCoordinate(90, 180));
+  ElementCounter firstCounter, secondCounter;
+  addTestData(1);
+  addTestData(2);
+  SearchPage firstPage(4);
+
+  elementStore.search({}, {"any"}, {}, boundingBox, LodRange(1, 1), firstCounter, firstPage, CancellationToken());
+  SearchPage secondPage(4, 0, firstPage.next());
+  elementStore.search({}, {"any"}, {}, boundingBox, LodRange(1, 1), secondCounter, secondPage, CancellationToken());
+
+  BOOST_CHECK_EQUAL(firstCounter.times, 4);
+  BOOST_CHECK(firstPage.next() != SearchPage::Start);
+  BOOST_CHECK_EQUAL(secondCounter.times, 2);
+  BOOST_CHECK(secondPage.next() == SearchPage::Start);
+}
+
+BOOST_AUTO_TEST_CASE(GivenData_WhenSearchWithOffset_ThenElementsAreSkipped) {
+  BoundingBox boundingBox(GeoCoordinate(-90, -180), GeoCoordinate(90, 180));
+  ElementCounter counter;
+  addTestData(1);
+  addTestData(2);
+  SearchPage page(2, 3);
+
+  elementStore.search({}, {"any"}, {}, boundingBox, LodRange(1, 1), counter, page, CancellationToken());
+
+  BOOST_CHECK_EQUAL(counter.times, 2);
+  BOOST_CHECK(page.next() != SearchPage::Start);
+}
+
+BOOST_AUTO_TEST_CASE(GivenBoundingBoxWithTooManyTiles_WhenSearchWithLimit_ThenThrowsBeforeVisiting) {
+  BoundingBox boundingBox(GeoCoordinate(-80, -180), GeoCoordinate(80, 180));
+  ElementCounter counter;
+  addTestData(1);
+  SearchPage page(1);
+
+  BOOST_CHECK_THROW(elementStore.search({}, {"any"}, {}, boundingBox, LodRange(1, 19), counter, page,
+                                        CancellationToken()), std::domain_error);
+
+  BOOST_CHECK_EQUAL(counter.times, 0);
+}
+
+BOOST_AUTO_TEST_CASE(GivenSameElementsStoredTwice_WhenSearch_ThenEachElementVisitedOnce) {
+  BoundingBox boundingBox(GeoCoordinate(-90, -180), GeoCoordinate(90, 180));
+  ElementCounter counter;
+  addTestData(1);
+  addTestData(1);
+
+  elementStore.search({}, {"any"}, {}, boundingBox, LodRange(1, 1), counter, CancellationToken());
+
+  BOOST_CHECK_EQUAL(counter.times, 3);
+}
+
+BOOST_AUTO_TEST_CASE(GivenData_WhenEraseByBoundingBoxAndLodRange_ThenItIsNotFound) {
+  BoundingBox boundingBox(GeoCoordinate(-90, -180), GeoCoordinate(90, 180));
+  ElementCounter quadKeyCounter, textCounter;
+  addTestData();
+
+  elementStore.erase(BoundingBox(GeoCoordinate(1, -10), GeoCoordinate(10, -1)), LodRange(1, 1));
+
+  elementStore.search(QuadKey(1, 0, 0), quadKeyCounter, CancellationToken());
+  elementStore.search({}, {"any"}, {}, boundingBox, LodRange(1, 1), textCounter, CancellationToken());
+  BOOST_CHECK(!elementStore.hasData(QuadKey(1, 0, 0)));
+  BOOST_CHECK_EQUAL(quadKeyCounter.times, 0);
+  BOOST_CHECK_EQUAL(textCounter.times, 0);
+}
+
+BOOST_AUTO_TEST_CASE(GivenRelationAndRolledBackWay_WhenSearch_ThenRelationIsReadBackWithMembers) {
+  QuadKey quadKey(1, 0, 0);
+  auto node = std::make_shared<Node>(ElementUtils::createElement<Node>(
+      *dependencyProvider.getStringTable(), 2, {{"any", "node"}}));
+  node->coordinate = {5, -5};
+  auto way = std::make_shared<Way>(ElementUtils::createElement<Way>(
+      *dependencyProvider.getStringTable(), 3, {{"any", "way"}}, {{5, -5}, {5, -10}}));
+  Relation relation = ElementUtils::createElement<Relation>(
+      *dependencyProvider.getStringTable(), 1, {{"any", "relation"}});
+  relation.elements = { node, way };
+  elementStore.save(relation, quadKey);
+  elementStore.begin();
+  elementStore.save(*way, quadKey);
+  elementStore.rollback();
+  RelationCollector collector;
+  ElementCounter counter;
+
+  elementStore.search(quadKey, counter, CancellationToken());
+  elementStore.search(quadKey, collector, CancellationToken());
+
+  BOOST_CHECK_EQUAL(counter.times, 1);
+  BOOST_REQUIRE_EQUAL(collector.relations.size(), 1);
+  const auto &result = collector.relations[0];
+  BOOST_CHECK_EQUAL(result.id, 1);
+  BOOST_CHECK_EQUAL(result.tags.size(), 1);
+  BOOST_REQUIRE_EQUAL(result.elements.size(), 2);
+  auto resultNode = std::dynamic_pointer_cast<Node>(result.elements[0]);
+  auto resultWay = std::dynamic_pointer_cast<Way>(result.elements[1]);
+  BOOST_REQUIRE(resultNode != nullptr && resultWay != nullptr);
+  BOOST_CHECK_EQUAL(resultNode->id, 2);
+  BOOST_CHECK_EQUAL(resultNode->coordinate.latitude, 5);
+  BOOST_CHECK_EQUAL(resultWay->id, 3);
+  BOOST_CHECK_EQUAL(resultWay->tags[0].value, way->tags[0].value);
+  BOOST_REQUIRE_EQUAL(resultWay->coordinates.size(), 2);
+  BOOST_CHECK_EQUAL(resultWay->coordinates[1].longitude, -10);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+#include "entities/Node.hpp"
+#include "index/SearchPage.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+
+using namespace utymap;
+using namespace utymap::entities;
+using namespace utymap::index;
+
+namespace {
+Node createNode(std::uint64_t id) {
+  Node node;
+  node.id = id;
+  return node;
+}
+
+/// Enters tiles of single row at given level of details till tile with given column.
+bool enterTiles(SearchPage &page, int lod, int lastTileX) {
+  bool isEntered = false;
+  for (int x = 0; x <= lastTileX; ++x)
+    isEntered = page.enterTile(QuadKey(lod, x, 0));
+  return isEntered;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(Index_SearchPage)
+
+BOOST_AUTO_TEST_CASE(GivenBigOrderAtHighestLod_WhenContinue_ThenStartsAfterLastElement) {
+  const int Lod = 19;
+  const std::uint32_t Order = 40000;
+  SearchPage page(1);
+  page.enterStore(1);
+  enterTiles(page, Lod, 2);
+  page.moveTo(Order);
+
+  BOOST_CHECK(page.accept(createNode(1)));
+  BOOST_CHECK(page.isFull());
+
+  SearchPage nextPage(1, 0, page.next());
+  BOOST_CHECK(!nextPage.isUnbounded());
+  BOOST_CHECK(!nextPage.enterStore(0));
+  BOOST_CHECK(nextPage.enterStore(1));
+  BOOST_CHECK(!enterTiles(nextPage, Lod, 1));
+  BOOST_CHECK(nextPage.enterTile(QuadKey(Lod, 2, 0)));
+  BOOST_CHECK_EQUAL(nextPage.firstOrder(), Order + 1);
+}
+
+BOOST_AUTO_TEST_CASE(GivenMaxOrder_WhenContinue_ThenLaterTilesStartFromFirstElement) {
+  SearchPage page(1);
+  page.enterStore(0);
+  enterTiles(page, 1, 1);
+  page.moveTo(std::numeric_limits<std::uint32_t>::max() - 1);
+  page.accept(createNode(1));
+
+  SearchPage nextPage(1, 0, page.next());
+  nextPage.enterStore(0);
+  BOOST_CHECK(enterTiles(nextPage, 1, 1));
+  BOOST_CHECK_EQUAL(nextPage.firstOrder(), std::numeric_limits<std::uint32_t>::max());
+  BOOST_CHECK(nextPage.enterTile(QuadKey(1, 0, 1)));
+  BOOST_CHECK_EQUAL(nextPage.firstOrder(), 0);
+  BOOST_CHECK(nextPage.enterTile(QuadKey(2, 0, 0)));
+  BOOST_CHECK_EQUAL(nextPage.firstOrder(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
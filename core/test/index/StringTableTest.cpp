@@ -3,6 +3,9 @@
 #include <boost/test/unit_test.hpp>
 #include "test_utils/DependencyProvider.hpp"
 
+#include <thread>
+#include <vector>
+
 using namespace utymap::index;
 using namespace utymap::tests;
 
@@ -50,4 +53,112 @@ BOOST_AUTO_TEST_CASE(GivenThreeStrings_WhenGetStringOfSecond_ThenReturnValidStri
   BOOST_CHECK_EQUAL(*str, "string2");
 }
 
+BOOST_AUTO_TEST_CASE(GivenStrings_WhenTableIsReopened_ThenSameIdsAndStringsReturned) {
+  {
+    StringTable stringTable("");
+    stringTable.getId("string1");
+    stringTable.getId("");
+    stringTable.getId("string3");
+  }
+
+  auto stringTable = dependencyProvider.getStringTable();
+
+  BOOST_CHECK_EQUAL(stringTable->getId("string3"), 2);
+  BOOST_CHECK_EQUAL(stringTable->getId(""), 1);
+  BOOST_CHECK_EQUAL(*stringTable->getString(0), "string1");
+  BOOST_CHECK_EQUAL(stringTable->getId("string4"), 3);
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyStrings_WhenGetIdConcurrently_ThenEachStringHasSingleId) {
+  const int threadCount = 4;
+  const int stringCount = 5000;
+  auto stringTable = dependencyProvider.getStringTable();
+  std::vector<std::vector<std::uint32_t>> ids(threadCount);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < threadCount; ++t) {
+    threads.push_back(std::thread([&, t]() {
+      for (int i = 0; i < stringCount; ++i)
+        ids[t].push_back(stringTable->getId("string" + std::to_string(i)));
+    }));
+  }
+  for (auto &thread : threads) thread.join();
+
+  BOOST_CHECK_EQUAL(stringTable->getId("new string"), stringCount);
+  for (int i = 0; i < stringCount; ++i) {
+    for (int t = 1; t < threadCount; ++t)
+      BOOST_CHECK_EQUAL(ids[t][i], ids[0][i]);
+    BOOST_CHECK_EQUAL(*stringTable->getString(ids[0][i]), "string" + std::to_string(i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(GivenBatchWithExistingAndDuplicatedStrings_WhenGetIds_ThenIdsAreConsistentWithGetId) {
+  auto stringTable = dependencyProvider.getStringTable();
+  stringTable->getId("string1");
+  std::string string1 = "string1", string2 = "string2", string3 = "string3";
+  std::vector<const std::string *> strings = { &string2, &string1, &string3, &string2 };
+  std::vector<std::uint32_t> ids;
+
+  stringTable->getIds(strings, ids);
+
+  BOOST_CHECK_EQUAL(ids.size(), 4);
+  BOOST_CHECK_EQUAL(ids[0], 1);
+  BOOST_CHECK_EQUAL(ids[1], 0);
+  BOOST_CHECK_EQUAL(ids[2], 2);
+  BOOST_CHECK_EQUAL(ids[3], 1);
+  BOOST_CHECK_EQUAL(stringTable->getId("string3"), 2);
+}
+
+BOOST_AUTO_TEST_CASE(GivenBatchOfStrings_WhenTableIsReopenedAndGetStrings_ThenSameStringsReturned) {
+  std::string string1 = "string1", empty = "", string3 = "string3";
+  {
+    StringTable stringTable("");
+    std::vector<std::uint32_t> ids;
+    stringTable.getIds({ &string1, &empty, &string3 }, ids);
+  }
+
+  std::vector<std::string> strings;
+  dependencyProvider.getStringTable()->getStrings({ 2, 1, 0, 10 }, strings);
+
+  BOOST_CHECK_EQUAL(strings.size(), 4);
+  BOOST_CHECK_EQUAL(strings[0], "string3");
+  BOOST_CHECK_EQUAL(strings[1], "");
+  BOOST_CHECK_EQUAL(strings[2], "string1");
+  BOOST_CHECK_EQUAL(strings[3], "");
+}
+
+BOOST_AUTO_TEST_CASE(GivenStringWithSeparators_WhenTableIsReopenedAndGetTokenIds_ThenIdsOfTokensReturned) {
+  std::uint32_t id;
+  {
+    StringTable stringTable("");
+    id = stringTable.getId("addr:street");
+  }
+  auto stringTable = dependencyProvider.getStringTable();
+
+  std::vector<std::uint32_t> tokenIds;
+  stringTable->getTokenIds(id, tokenIds);
+  stringTable->getTokenIds(stringTable->getId("street"), tokenIds);
+
+  BOOST_CHECK_EQUAL(id, 0);
+  BOOST_CHECK_EQUAL(tokenIds.size(), 3);
+  BOOST_CHECK_EQUAL(tokenIds[0], stringTable->getId("addr"));
+  BOOST_CHECK_EQUAL(tokenIds[1], stringTable->getId("street"));
+  BOOST_CHECK_EQUAL(tokenIds[2], tokenIds[1]);
+  BOOST_CHECK_EQUAL(stringTable->getId("street"), 2);
+}
+
+BOOST_AUTO_TEST_CASE(GivenTokens_WhenGetPrefixIds_ThenAllMatchingTokensReturnedInOrder) {
+  auto stringTable = dependencyProvider.getStringTable();
+  stringTable->getId("name:Brandenburger Tor");
+  stringTable->getId("Bran");
+  stringTable->getId("Bram");
+
+  std::vector<std::uint32_t> ids;
+  stringTable->getPrefixIds("Bran", ids);
+
+  BOOST_CHECK_EQUAL(ids.size(), 2);
+  BOOST_CHECK_EQUAL(ids[0], stringTable->getId("Bran"));
+  BOOST_CHECK_EQUAL(ids[1], stringTable->getId("Brandenburger"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
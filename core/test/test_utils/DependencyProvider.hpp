@@ -23,6 +23,7 @@ class DependencyProvider {
 
     bool hasError = std::remove("string.idx") > 0;
     hasError = std::remove("string.dat") > 0 || hasError;
+    hasError = std::remove("string.tok") > 0 || hasError;
 
     if (hasError)
       std::cout << "Error while deleting index files.";
@@ -176,12 +176,14 @@ namespace Assets.Scripts.Core.Interop
         private UtyRx.IObservable<int> Get(MapQuery query, int tag, OnElementLoaded elementLoadedHandler, OnError errorHandler)
         {
             _trace.Debug(TraceCategory, "Search elements");
-            WithCancelToken(new CancellationToken(), (cancelTokenHandle) => getDataByText(
-                tag, query.NotTerms, query.AndTerms, query.OrTerms,
-                query.BoundingBox.MinPoint.Latitude, query.BoundingBox.MinPoint.Longitude,
-                query.BoundingBox.MaxPoint.Latitude, query.BoundingBox.MaxPoint.Longitude,
-                query.LodRange.Minimum, query.LodRange.Maximum, elementLoadedHandler, errorHandler,
-                cancelTokenHandle.AddrOfPinnedObject())
+            WithCancelToken(new CancellationToken(), (cancelTokenHandle) =>
+                query.NextContinuation = getDataByText(
+                    tag, query.NotTerms, query.AndTerms, query.OrTerms,
+                    query.BoundingBox.MinPoint.Latitude, query.BoundingBox.MinPoint.Longitude,
+                    query.BoundingBox.MaxPoint.Latitude, query.BoundingBox.MaxPoint.Longitude,
+                    query.LodRange.Minimum, query.LodRange.Maximum,
+                    query.Limit, query.Offset, query.Continuation, elementLoadedHandler, errorHandler,
+                    cancelTokenHandle.AddrOfPinnedObject())
             );
             return Observable.Return(100);
         }
@@ -272,9 +274,9 @@ namespace Assets.Scripts.Core.Interop
             OnMeshBuilt meshBuiltHandler, OnElementLoaded elementLoadedHandler, OnError errorHandler, IntPtr cancelToken);
 
         [DllImport("UtyMap.Shared")]
-        private static extern void getDataByText(int tag, string notTerms, string andTerms, string orTerms,
+        private static extern ulong getDataByText(int tag, string notTerms, string andTerms, string orTerms,
             double minLatitude, double minLogitude, double maxLatitude, double maxLogitude,
-            int startLod, int endLod,
+            int startLod, int endLod, int limit, int offset, ulong continuation,
             OnElementLoaded elementLoadedHandler, OnError errorHandler, IntPtr cancelToken);
 
         [DllImport("UtyMap.Shared")]
@@ -20,17 +20,38 @@ namespace UtyMap.Unity
         /// <summary> LOD range constraint. </summary>
         public readonly Range<int> LodRange;
 
+        /// <summary> Max amount of elements to return, zero means no limit. </summary>
+        public readonly int Limit;
+
+        /// <summary> Amount of matching elements to skip. </summary>
+        public readonly int Offset;
+
+        /// <summary> Continuation token of the page, zero for the first one. </summary>
+        public readonly ulong Continuation;
+
+        /// <summary> Continuation token of the next page, zero if there are no more results. </summary>
+        public ulong NextContinuation { get; set; }
+
         /// <summary> Used to cancel query in native code. </summary>
         public readonly CancellationToken CancelToken;
 
         public MapQuery(string notTerms, string andTerms, string orTerms,
-            BoundingBox boundingBox, Range<int> lodRange)
+            BoundingBox boundingBox, Range<int> lodRange) :
+            this(notTerms, andTerms, orTerms, boundingBox, lodRange, 0, 0, 0)
+        {
+        }
+
+        public MapQuery(string notTerms, string andTerms, string orTerms,
+            BoundingBox boundingBox, Range<int> lodRange, int limit, int offset, ulong continuation)
         {
             NotTerms = notTerms;
             AndTerms = andTerms;
             OrTerms = orTerms;
             BoundingBox = boundingBox;
             LodRange = lodRange;
+            Limit = limit;
+            Offset = offset;
+            Continuation = continuation;
 
             CancelToken = new CancellationToken();
         }